@@ -0,0 +1,52 @@
+#ifndef SYNTH_H
+#define SYNTH_H
+
+#include <ostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+//synthetic vec source for the drivers to chew on
+
+//module number m: a type and funcs functions, each with some arithmetic, an if, and an
+//implied loop with a reduction. the functions are named f<m>_<i>
+inline void writeModule(std::ostream& os, int m, int funcs)
+{
+    os << "type P" << m << " = {int x, int y};\n";
+    for (int i = 0; i < funcs; ++i)
+        os << "int:{int, int} f" << m << '_' << i << " {a, b}\n"
+            "(\n"
+            "    int s = a * " << i + 1 << " + b;\n"
+            "    if (s > " << i << ")\n"
+            "        s = s - b;\n"
+            "    else\n"
+            "        s = s + a;\n"
+            "    [int]!4 q;\n"
+            "    `q = `q * s;\n"
+            "    int m = += `q;\n"
+            "    return s + m;\n"
+            ");\n";
+}
+
+//a main module with a little work of its own
+inline void writeMain(std::ostream& os)
+{
+    os << "int:[String] main {args}\n"
+        "(\n"
+        "    [int]!8 a;\n"
+        "    `a = `a + 1;\n"
+        "    return += `a;\n"
+        ");\n";
+}
+
+//write module m to <prefix><m>.bench.vc and return the path
+inline std::string writeModuleFile(const std::string& prefix, int m, int funcs)
+{
+    std::stringstream path;
+    path << prefix << m << ".bench.vc";
+    std::ofstream out(path.str().c_str());
+    writeModule(out, m, funcs);
+    return path.str();
+}
+
+#endif
@@ -0,0 +1,50 @@
+//parses and lowers one big module and reports the time, how many nodes were allocated,
+//and peak RSS. "arena heap" allocates each node from the heap instead, for comparison.
+//run each in its own process, or the RSS numbers mix. "arena [heap] <functions>" for
+//another size
+#include "Global.h"
+#include "Synth.h"
+
+#include <chrono>
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+
+#include <sys/resource.h>
+
+int main(int argc, char* argv[])
+{
+    int arg = 1;
+    bool heap = argc > arg && strcmp(argv[arg], "heap") == 0;
+    if (heap)
+        ++arg;
+    int funcs = argc > arg ? atoi(argv[arg]) : 20000;
+    if (funcs <= 0)
+    {
+        std::cerr << "usage: arena [heap] [functions]\n";
+        return 1;
+    }
+
+    std::string path = writeModuleFile("arena", 0, funcs);
+
+    GlobalData::create();
+    Global().moduleCache.setDir(""); //it has to actually be parsed
+    utl::Arena::heapMode = heap;
+
+    typedef std::chrono::high_resolution_clock Clock;
+    Clock::time_point start = Clock::now();
+    std::vector<ast::Module*> mods = Global().ParseFiles(std::vector<std::string>(1, path));
+    double millis = std::chrono::duration_cast<std::chrono::microseconds>(
+        Clock::now() - start).count() / 1000.;
+
+    utl::Arena& arena = mods[0]->nodeArena;
+    std::cout << "arena" << (heap ? " (heap)" : "") << ": " << funcs << " functions in "
+        << millis << " ms, " << arena.numAllocations() << " allocations, "
+        << arena.bytesUsed() << " bytes used, " << arena.bytesReserved() << " bytes reserved";
+
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+        std::cout << ", peak rss " << usage.ru_maxrss << " KB";
+    std::cout << '\n';
+    return 0;
+}
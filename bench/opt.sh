@@ -0,0 +1,42 @@
+#!/bin/bash
+#runs each program in programs/ under the jit at -O0 to -O3 and prints a table of how
+#long main took, the best of a few runs. "opt.sh [vc [runs]]", from the bench directory
+vc=$(cd "$(dirname "${1:-../vc}")" && pwd)/$(basename "${1:-../vc}")
+runs=${2:-5}
+here=$(cd "$(dirname "$0")" && pwd)
+
+if [ ! -x "$vc" ]; then
+    echo "usage: opt.sh [vc [runs]]. build vc first (make in the top directory)" >&2
+    exit 1
+fi
+
+#the compiler writes its dot files next to the source, so work on copies
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+
+printf "%-12s %10s %10s %10s %10s\n" "ms" -O0 -O1 -O2 -O3
+for prog in "$here"/programs/*.vc; do
+    name=$(basename "$prog" .vc)
+    cp "$prog" "$dir"
+    row=$(printf "%-12s" "$name")
+    for level in 0 1 2 3; do
+        best=
+        for ((i = 0; i < runs; ++i)); do
+            #"run: 12.5 ms, main returned 1". the programs return 1 if they got the right answer
+            out=$(cd "$dir" && "$vc" --no-cache -O$level --run "$name.vc" 2>&1)
+            ms=$(echo "$out" | sed -n 's/^run: \([0-9.]*\) ms, main returned 1$/\1/p')
+            if [ -z "$ms" ]; then
+                #say why, rather than leave a program that doesn't compile as just "failed"
+                why=$(echo "$out" | head -n 1)
+                echo "$name -O$level: ${why:-vc printed nothing}" >&2
+                best=failed
+                break
+            fi
+            if [ -z "$best" ] || awk "BEGIN { exit !($ms < $best) }"; then
+                best=$ms
+            fi
+        done
+        row="$row $(printf "%10s" "$best")"
+    done
+    echo "$row"
+done
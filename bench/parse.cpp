@@ -0,0 +1,62 @@
+//parses and lowers a synthetic project of 200 modules, first on one thread and then on
+//one per processor, and reports the speedup. the second run gets modules of its own, so
+//neither finds the other's identifiers already interned. "parse <modules> <functions>
+//<threads>" for other sizes
+#include "Global.h"
+#include "Parallel.h"
+#include "Synth.h"
+
+#include <chrono>
+#include <iostream>
+#include <vector>
+#include <cstdlib>
+
+namespace
+{
+    typedef std::chrono::high_resolution_clock Clock;
+
+    double millis(Clock::duration d)
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(d).count() / 1000.;
+    }
+
+    //modules [first, first + count) on jobs threads. returns how long it took
+    double parse(int first, int count, int funcs, unsigned jobs)
+    {
+        std::vector<std::string> paths;
+        for (int m = first; m < first + count; ++m)
+            paths.push_back(writeModuleFile("parse", m, funcs));
+
+        Global().options.jobs = jobs;
+        Global().ParseFiles(paths);
+        return Global().parseMillis;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    int modules = argc > 1 ? atoi(argv[1]) : 200;
+    int funcs = argc > 2 ? atoi(argv[2]) : 50;
+    int threads = argc > 3 ? atoi(argv[3]) : 0;
+    if (modules <= 0 || funcs <= 0 || threads < 0)
+    {
+        std::cerr << "usage: parse [modules [functions [threads]]]\n";
+        return 1;
+    }
+
+    GlobalData::create();
+    Global().moduleCache.setDir("");
+
+    double serial = parse(0, modules, funcs, 1);
+    double parallel = parse(modules, modules, funcs, threads);
+    if (Global().numErrors)
+    {
+        std::cerr << "parse: the synthetic modules had errors\n";
+        return 1;
+    }
+
+    std::cout << "parse: " << modules << " modules of " << funcs << " functions. "
+        << serial << " ms on 1 thread, " << parallel << " ms on " << Global().parseThreads
+        << " (" << (parallel > 0 ? serial / parallel : 0) << "x)\n";
+    return 0;
+}
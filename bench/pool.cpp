@@ -0,0 +1,113 @@
+//times the runtime's thread pool on 16M floats: an element-wise kernel (y = a * x + y)
+//through vec_parallel_for, and vec_reduce_add on the same data, with VEC_THREADS from 1 to
+//one per processor. the pool reads VEC_THREADS once, so each thread count runs in a
+//process of its own, forked before the pool starts. "pool <elements> <threads>" for
+//another size or a different highest thread count
+#include "../runtime/pool.h"
+#include "../runtime/reduce.h"
+
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include <cstdlib>
+
+#include <unistd.h>
+#include <sys/wait.h>
+
+namespace
+{
+    typedef std::chrono::high_resolution_clock Clock;
+
+    double millis(Clock::duration d)
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(d).count() / 1000.;
+    }
+
+    struct Saxpy
+    {
+        float a;
+        const float* x;
+        float* y;
+    };
+
+    void saxpy(void* ctx, int32_t begin, int32_t end)
+    {
+        Saxpy* s = static_cast<Saxpy*>(ctx);
+        for (int32_t i = begin; i < end; ++i)
+            s->y[i] = s->a * s->x[i] + s->y[i];
+    }
+
+    //the best of a few runs of each, on however many threads the pool has
+    void run(int32_t n)
+    {
+        std::vector<float> x(n, 1.f), y(n, 2.f);
+        Saxpy s = {.5f, x.data(), y.data()};
+
+        const int reps = 5;
+        double kernel = 0, reduce = 0;
+        float sum = 0;
+        for (int r = 0; r < reps; ++r)
+        {
+            Clock::time_point start = Clock::now();
+            vec_parallel_for(saxpy, &s, n);
+            Clock::time_point mid = Clock::now();
+            sum = vec_reduce_add_f32(y.data(), n, 0);
+            Clock::time_point end = Clock::now();
+
+            if (r == 0 || millis(mid - start) < kernel)
+                kernel = millis(mid - start);
+            if (r == 0 || millis(end - mid) < reduce)
+                reduce = millis(end - mid);
+        }
+
+        //every element is 2 + .5 * reps
+        float want = float(n) * (2.f + .5f * reps);
+        bool ok = sum > want * .99f && sum < want * 1.01f;
+
+        std::cout << "pool: " << vec_pool_threads() << " threads, " << kernel
+            << " ms element-wise, " << reduce << " ms reduce"
+            << (ok ? "" : " (wrong sum)") << std::endl;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    int32_t n = argc > 1 ? atoi(argv[1]) : 1 << 24;
+    int threads = argc > 2 ? atoi(argv[2]) : int(std::thread::hardware_concurrency());
+    if (threads <= 0)
+        threads = 1;
+    if (n <= 0)
+    {
+        std::cerr << "usage: pool [elements [threads]]\n";
+        return 1;
+    }
+
+    for (int t = 1; t <= threads; ++t)
+    {
+        pid_t pid = fork();
+        if (pid < 0)
+        {
+            std::cerr << "pool: cannot fork\n";
+            return 1;
+        }
+        if (pid == 0)
+        {
+            std::stringstream ss;
+            ss << t;
+            setenv("VEC_THREADS", ss.str().c_str(), 1);
+            run(n);
+            _exit(0);
+        }
+
+        int status;
+        waitpid(pid, &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        {
+            std::cerr << "pool: the run on " << t << " threads failed\n";
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,91 @@
+//makes 100k distinct tuple types and 100k distinct named types, and reports how long
+//uniquing them took. then estimates what the old list scan would have cost, by timing the
+//scan for every 100th type. "types <count>" for another size
+#include "Global.h"
+#include "Type.h"
+
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <cstdlib>
+
+namespace
+{
+    typedef std::chrono::high_resolution_clock Clock;
+
+    double millis(Clock::duration d)
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(d).count() / 1000.;
+    }
+
+    Ident name(const char* prefix, long i)
+    {
+        std::stringstream ss;
+        ss << prefix << i;
+        return Global().addIdent(ss.str());
+    }
+}
+
+#define SAMPLE 100
+
+int main(int argc, char* argv[])
+{
+    long count = argc > 1 ? atol(argv[1]) : 100000;
+    if (count <= 0)
+    {
+        std::cerr << "usage: types [count]\n";
+        return 1;
+    }
+
+    GlobalData::create();
+
+    //names first, so interning isn't timed
+    std::vector<Ident> fields, names;
+    for (long i = 0; i < count; ++i)
+    {
+        fields.push_back(name("f", i));
+        names.push_back(name("T", i));
+    }
+
+    std::vector<typ::Type> made;
+    Clock::time_point start = Clock::now();
+    for (long i = 0; i < count; ++i)
+    {
+        typ::TupleBuilder builder;
+        builder.push_back(typ::int32, fields[i]);
+        builder.push_back(typ::mgr.makeList(typ::float64), Global().reserved.null);
+        made.push_back(typ::mgr.makeTuple(builder));
+    }
+    Clock::time_point tuples = Clock::now();
+    for (long i = 0; i < count; ++i)
+        made.push_back(typ::mgr.makeNamed(made[i], names[i]));
+    Clock::time_point named = Clock::now();
+
+    //making them again should find every one
+    for (long i = 0; i < count; ++i)
+    {
+        typ::TupleBuilder builder;
+        builder.push_back(typ::int32, fields[i]);
+        builder.push_back(typ::mgr.makeList(typ::float64), Global().reserved.null);
+        if (typ::mgr.makeTuple(builder) != made[i])
+        {
+            std::cerr << "types: tuple " << i << " wasn't uniqued\n";
+            return 1;
+        }
+    }
+    Clock::time_point again = Clock::now();
+
+    size_t compared = 0;
+    Clock::time_point scanStart = Clock::now();
+    for (size_t i = 0; i < made.size(); i += SAMPLE)
+        compared += typ::mgr.scanFor(made[i]);
+    double scanMillis = millis(Clock::now() - scanStart) * SAMPLE;
+
+    std::cout << "types: " << count << " tuples in " << millis(tuples - start) << " ms, "
+        << count << " named in " << millis(named - tuples) << " ms, "
+        << count << " tuples again in " << millis(again - named) << " ms\n"
+        << "types: a list scan would have compared about " << compared * SAMPLE
+        << " nodes in about " << scanMillis << " ms\n";
+    return 0;
+}
@@ -0,0 +1,78 @@
+//parses and lowers a module of 5k functions, then times walking the whole tree for
+//OverloadCallExprs with Subtree, which checks node kinds. for comparison it also times
+//the same walk checking typeids, the way exact_cast used to. "walk <functions> <walks>"
+//for other sizes
+#include "Global.h"
+#include "AstWalker.h"
+#include "Expr.h"
+#include "Synth.h"
+
+#include <chrono>
+#include <iostream>
+#include <typeinfo>
+#include <cstdlib>
+
+using namespace sa;
+
+namespace
+{
+    typedef std::chrono::high_resolution_clock Clock;
+
+    double millis(Clock::duration d)
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(d).count() / 1000.;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    int funcs = argc > 1 ? atoi(argv[1]) : 5000;
+    int walks = argc > 2 ? atoi(argv[2]) : 20;
+    if (funcs <= 0 || walks <= 0)
+    {
+        std::cerr << "usage: walk [functions [walks]]\n";
+        return 1;
+    }
+
+    std::string path = writeModuleFile("walk", 0, funcs);
+
+    GlobalData::create();
+    Global().moduleCache.setDir("");
+    ast::Module* mod = Global().ParseFiles(std::vector<std::string>(1, path))[0];
+
+    size_t nodes = 0;
+    for (auto n : Subtree<>(mod))
+    {
+        (void)n;
+        ++nodes;
+    }
+
+    size_t byKind = 0;
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < walks; ++i)
+        for (auto call : Subtree<ast::OverloadCallExpr>(mod))
+        {
+            (void)call;
+            ++byKind;
+        }
+    Clock::time_point kinds = Clock::now();
+
+    size_t byTypeid = 0;
+    for (int i = 0; i < walks; ++i)
+        for (auto n : Subtree<>(mod))
+            if (typeid(*n) == typeid(ast::OverloadCallExpr))
+                ++byTypeid;
+    Clock::time_point typeids = Clock::now();
+
+    if (byKind != byTypeid)
+    {
+        std::cerr << "walk: found " << byKind << " calls by kind but " << byTypeid
+            << " by typeid\n";
+        return 1;
+    }
+
+    std::cout << "walk: " << nodes << " nodes, " << byKind / walks << " calls. "
+        << millis(kinds - start) / walks << " ms per walk by kind, "
+        << millis(typeids - kinds) / walks << " ms per walk by typeid\n";
+    return 0;
+}
@@ -0,0 +1,107 @@
+#include "list.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+#define MIN_CAPACITY 8
+
+static void* allocData(size_t size)
+{
+    void* ret;
+#ifdef _WIN32
+    ret = _aligned_malloc(size, VEC_LIST_ALIGN);
+#else
+    if (posix_memalign(&ret, VEC_LIST_ALIGN, size))
+        ret = NULL;
+#endif
+    if (!ret)
+    {
+        fputs("vec: out of memory\n", stderr);
+        abort();
+    }
+    return ret;
+}
+
+static void freeData(void* p)
+{
+#ifdef _WIN32
+    _aligned_free(p);
+#else
+    free(p);
+#endif
+}
+
+void vec_list_reserve(vec_list* l, int32_t len, int32_t elemSize)
+{
+    int32_t cap;
+    void* data;
+    if (len <= l->cap)
+        return;
+
+    cap = l->cap * 2;
+    if (cap < len)
+        cap = len;
+    if (cap < MIN_CAPACITY)
+        cap = MIN_CAPACITY;
+
+    /* there's no aligned realloc, so always copy */
+    data = allocData((size_t)cap * elemSize);
+    if (l->len)
+        memcpy(data, l->data, (size_t)l->len * elemSize);
+    if (l->cap)
+        freeData(l->data);
+
+    l->data = data;
+    l->cap = cap;
+}
+
+void vec_list_append(vec_list* l, const void* src, int32_t n, int32_t elemSize)
+{
+    uintptr_t begin = (uintptr_t)l->data;
+    uintptr_t end = begin + (size_t)l->cap * elemSize;
+    uintptr_t s = (uintptr_t)src;
+
+    if (n <= 0)
+        return;
+
+    /* x = x $ x. reserve may free the data out from under src. borrowed data
+       is never freed, so only owned data has to be checked */
+    if (s >= begin && s < end)
+    {
+        vec_list_reserve(l, l->len + n, elemSize);
+        src = (char*)l->data + (s - begin);
+    }
+    else
+        vec_list_reserve(l, l->len + n, elemSize);
+
+    memmove((char*)l->data + (size_t)l->len * elemSize, src, (size_t)n * elemSize);
+    l->len += n;
+}
+
+void vec_list_concat(vec_list* out, const vec_list* a, const vec_list* b, int32_t elemSize)
+{
+    vec_list ret = {NULL, 0, 0};
+    vec_list_reserve(&ret, a->len + b->len, elemSize);
+
+    if (a->len)
+        memcpy(ret.data, a->data, (size_t)a->len * elemSize);
+    if (b->len)
+        memcpy((char*)ret.data + (size_t)a->len * elemSize, b->data, (size_t)b->len * elemSize);
+    ret.len = a->len + b->len;
+
+    *out = ret;
+}
+
+void vec_list_free(vec_list* l)
+{
+    if (l->cap)
+        freeData(l->data);
+    l->data = NULL;
+    l->len = 0;
+    l->cap = 0;
+}
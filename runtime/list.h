@@ -0,0 +1,55 @@
+#ifndef VEC_LIST_H
+#define VEC_LIST_H
+
+#include <stdint.h>
+
+/* runtime support for vec lists. compiled code calls these for anything that
+   changes the size of a list.
+
+   a variable length list, [T], is {T* data, int32_t len, int32_t cap}. data is
+   aligned to VEC_LIST_ALIGN so whole vector registers can be loaded from it. a
+   list with cap == 0 doesn't own its data: it's never freed, and growing it
+   copies the elements into a new buffer. host code can hand its own arrays to
+   compiled code this way without copying them.
+
+   copying a list copies only the struct, so copies share data. compiled code
+   only grows a list in place, or frees it, when nothing else can be sharing its
+   data. see ast::Lambda::generate.
+
+   a fixed length list, [T]!n, is a T[n]. functions take them by pointer. */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define VEC_LIST_ALIGN 64
+
+/* the layout of every variable length list */
+typedef struct vec_list
+{
+    void* data;
+    int32_t len;
+    int32_t cap; /* number of elements data has room for */
+} vec_list;
+
+/* the same thing with a real element type, for host code */
+#define VEC_LIST(T) struct { T* data; int32_t len; int32_t cap; }
+
+/* make room for at least len elements. capacity grows geometrically so appending
+   one element at a time is amortized constant time */
+void vec_list_reserve(vec_list* l, int32_t len, int32_t elemSize);
+
+/* append n elements starting at src. src may point into l's own data */
+void vec_list_append(vec_list* l, const void* src, int32_t n, int32_t elemSize);
+
+/* out = a $ b, in a new buffer */
+void vec_list_concat(vec_list* out, const vec_list* a, const vec_list* b, int32_t elemSize);
+
+/* free l's data if it owns it, and leave it empty */
+void vec_list_free(vec_list* l);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,378 @@
+#include "pool.h"
+
+#include <stdlib.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif !defined(VEC_NO_THREADS)
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#define MAX_THREADS 64
+#define DEFAULT_GRAIN 4096
+
+/* splitting in half each time, a deque never holds more than one range per bit of n */
+#define DEQUE_SIZE 64
+
+/* portability. mutexes, condition variables, and the thread local flag */
+#if defined(_WIN32)
+typedef CRITICAL_SECTION mutex;
+typedef CONDITION_VARIABLE condvar;
+#define mutexInit(m) InitializeCriticalSection(m)
+#define lock(m) EnterCriticalSection(m)
+#define unlock(m) LeaveCriticalSection(m)
+#define condInit(c) InitializeConditionVariable(c)
+#define condWait(c, m) SleepConditionVariableCS(c, m, INFINITE)
+#define condWakeAll(c) WakeAllConditionVariable(c)
+#define THREAD_LOCAL __declspec(thread)
+#elif !defined(VEC_NO_THREADS)
+typedef pthread_mutex_t mutex;
+typedef pthread_cond_t condvar;
+#define mutexInit(m) pthread_mutex_init(m, NULL)
+#define lock(m) pthread_mutex_lock(m)
+#define unlock(m) pthread_mutex_unlock(m)
+#define condInit(c) pthread_cond_init(c, NULL)
+#define condWait(c, m) pthread_cond_wait(c, m)
+#define condWakeAll(c) pthread_cond_broadcast(c)
+#define THREAD_LOCAL __thread
+#endif
+
+#if defined(_WIN32) || !defined(VEC_NO_THREADS)
+
+typedef struct
+{
+    int32_t begin, end;
+} range;
+
+/* the owner pushes and pops at the bottom, thieves take from the top */
+typedef struct
+{
+    mutex lock;
+    range items[DEQUE_SIZE];
+    int32_t top, bottom;
+} deque;
+
+static struct
+{
+    int32_t threads;
+    int32_t grain;
+
+    mutex lock; /* everything from here down */
+    condvar wake; /* workers wait here for a job, or for something to steal */
+    condvar done; /* the caller waits for the workers here */
+    int busy; /* a job is running */
+    unsigned generation; /* bumped for each job */
+    int32_t working; /* workers that haven't noticed the job is finished */
+    int32_t left; /* elements not done yet */
+    unsigned pushes; /* bumped when ranges are pushed for thieves */
+
+    vec_range_fn fn;
+    void* ctx;
+    int32_t jobGrain;
+
+    deque deques[MAX_THREADS];
+} pool;
+
+/* set on pool threads, and on the caller while it's running a job */
+static THREAD_LOCAL int inPool;
+
+static int32_t envInt(const char* name, int32_t dflt)
+{
+    const char* s = getenv(name);
+    long v;
+    if (!s || !*s)
+        return dflt;
+    v = strtol(s, NULL, 10);
+    return v > 0 ? (int32_t)v : dflt;
+}
+
+static int32_t numProcessors(void)
+{
+#if defined(_WIN32)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (int32_t)info.dwNumberOfProcessors;
+#else
+    return (int32_t)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+}
+
+/* 0 if the deque is full */
+static int push(deque* d, range r)
+{
+    int pushed = 0;
+    lock(&d->lock);
+    if (d->bottom < DEQUE_SIZE)
+    {
+        d->items[d->bottom++] = r;
+        pushed = 1;
+    }
+    unlock(&d->lock);
+    return pushed;
+}
+
+static int pop(deque* d, range* r)
+{
+    int found = 0;
+    lock(&d->lock);
+    if (d->bottom > d->top)
+    {
+        *r = d->items[--d->bottom];
+        found = 1;
+    }
+    if (d->bottom == d->top)
+        d->bottom = d->top = 0;
+    unlock(&d->lock);
+    return found;
+}
+
+static int steal(deque* d, range* r)
+{
+    int found = 0;
+    lock(&d->lock);
+    if (d->bottom > d->top)
+    {
+        *r = d->items[d->top++];
+        found = 1;
+    }
+    if (d->bottom == d->top)
+        d->bottom = d->top = 0;
+    unlock(&d->lock);
+    return found;
+}
+
+/* run ranges until the job is finished. self is the worker's own deque */
+static void work(int32_t self)
+{
+    deque* mine = &pool.deques[self];
+    range r;
+    int32_t victim, done;
+    unsigned pushes;
+    int pushed;
+
+    for (;;)
+    {
+        if (!pop(mine, &r))
+        {
+            int found = 0;
+
+            /* anything pushed after this is noticed below, so the wakeup isn't lost */
+            lock(&pool.lock);
+            pushes = pool.pushes;
+            unlock(&pool.lock);
+
+            for (victim = 1; victim < pool.threads && !found; ++victim)
+                found = steal(&pool.deques[(self + victim) % pool.threads], &r);
+
+            if (!found)
+            {
+                lock(&pool.lock);
+                while (pool.left != 0 && pool.pushes == pushes)
+                    condWait(&pool.wake, &pool.lock);
+                done = pool.left == 0;
+                unlock(&pool.lock);
+                if (done)
+                    return;
+                continue;
+            }
+        }
+
+        /* leave the far half for a thief */
+        pushed = 0;
+        while (r.end - r.begin > pool.jobGrain)
+        {
+            range back;
+            back.begin = r.begin + (r.end - r.begin) / 2;
+            back.end = r.end;
+            if (!push(mine, back))
+                break;
+            r.end = back.begin;
+            pushed = 1;
+        }
+        if (pushed)
+        {
+            lock(&pool.lock);
+            ++pool.pushes;
+            condWakeAll(&pool.wake);
+            unlock(&pool.lock);
+        }
+
+        pool.fn(pool.ctx, r.begin, r.end);
+
+        lock(&pool.lock);
+        pool.left -= r.end - r.begin;
+        if (pool.left == 0)
+            condWakeAll(&pool.wake);
+        unlock(&pool.lock);
+    }
+}
+
+#if defined(_WIN32)
+static DWORD WINAPI worker(LPVOID arg)
+#else
+static void* worker(void* arg)
+#endif
+{
+    int32_t self = (int32_t)(size_t)arg;
+    unsigned seen = 0;
+    inPool = 1;
+
+    for (;;)
+    {
+        lock(&pool.lock);
+        while (pool.generation == seen)
+            condWait(&pool.wake, &pool.lock);
+        seen = pool.generation;
+        unlock(&pool.lock);
+
+        work(self);
+
+        lock(&pool.lock);
+        if (--pool.working == 0)
+            condWakeAll(&pool.done);
+        unlock(&pool.lock);
+    }
+#if defined(_WIN32)
+    return 0;
+#else
+    return NULL;
+#endif
+}
+
+static void startThreads(void)
+{
+    int32_t i;
+
+    pool.threads = envInt("VEC_THREADS", numProcessors());
+    if (pool.threads > MAX_THREADS)
+        pool.threads = MAX_THREADS;
+    pool.grain = envInt("VEC_GRAIN", DEFAULT_GRAIN);
+
+    mutexInit(&pool.lock);
+    condInit(&pool.wake);
+    condInit(&pool.done);
+    for (i = 0; i < MAX_THREADS; ++i)
+        mutexInit(&pool.deques[i].lock);
+
+    for (i = 1; i < pool.threads; ++i)
+    {
+#if defined(_WIN32)
+        HANDLE t = CreateThread(NULL, 0, worker, (LPVOID)(size_t)i, 0, NULL);
+        if (!t)
+            break;
+        CloseHandle(t);
+#else
+        pthread_t t;
+        if (pthread_create(&t, NULL, worker, (void*)(size_t)i) != 0)
+            break;
+        pthread_detach(t);
+#endif
+    }
+    /* however many actually started */
+    pool.threads = i;
+}
+
+#if defined(_WIN32)
+static INIT_ONCE started = INIT_ONCE_STATIC_INIT;
+
+static BOOL CALLBACK startOnce(PINIT_ONCE once, PVOID param, PVOID* ctx)
+{
+    (void)once;
+    (void)param;
+    (void)ctx;
+    startThreads();
+    return TRUE;
+}
+#else
+static pthread_once_t started = PTHREAD_ONCE_INIT;
+#endif
+
+/* 0 if the pool is, or has to be, single threaded. safe to call from any thread */
+static int startPool(void)
+{
+#if defined(_WIN32)
+    InitOnceExecuteOnce(&started, startOnce, NULL, NULL);
+#else
+    pthread_once(&started, startThreads);
+#endif
+    return pool.threads > 1;
+}
+
+void vec_parallel_for_grain(vec_range_fn fn, void* ctx, int32_t n, int32_t grain)
+{
+    range all;
+    int claimed = 0;
+
+    if (n > grain && !inPool && startPool())
+    {
+        lock(&pool.lock);
+        if (!pool.busy)
+            claimed = pool.busy = 1;
+        unlock(&pool.lock);
+    }
+
+    if (!claimed)
+    {
+        if (n > 0)
+            fn(ctx, 0, n);
+        return;
+    }
+
+    pool.fn = fn;
+    pool.ctx = ctx;
+    pool.jobGrain = grain < 1 ? 1 : grain;
+    pool.left = n;
+    all.begin = 0;
+    all.end = n;
+    push(&pool.deques[0], all);
+
+    lock(&pool.lock);
+    pool.working = pool.threads - 1;
+    ++pool.generation;
+    condWakeAll(&pool.wake);
+    unlock(&pool.lock);
+
+    inPool = 1;
+    work(0);
+    inPool = 0;
+
+    /* the workers might still be looking at the deques */
+    lock(&pool.lock);
+    while (pool.working > 0)
+        condWait(&pool.done, &pool.lock);
+    pool.busy = 0;
+    unlock(&pool.lock);
+}
+
+int32_t vec_pool_threads(void)
+{
+    startPool();
+    return pool.threads;
+}
+
+#else /* VEC_NO_THREADS */
+
+void vec_parallel_for_grain(vec_range_fn fn, void* ctx, int32_t n, int32_t grain)
+{
+    (void)grain;
+    if (n > 0)
+        fn(ctx, 0, n);
+}
+
+int32_t vec_pool_threads(void)
+{
+    return 1;
+}
+
+#endif
+
+void vec_parallel_for(vec_range_fn fn, void* ctx, int32_t n)
+{
+#if defined(_WIN32) || !defined(VEC_NO_THREADS)
+    startPool();
+    vec_parallel_for_grain(fn, ctx, n, pool.grain);
+#else
+    vec_parallel_for_grain(fn, ctx, n, DEFAULT_GRAIN);
+#endif
+}
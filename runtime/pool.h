@@ -0,0 +1,45 @@
+#ifndef VEC_POOL_H
+#define VEC_POOL_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* the thread pool that parallel implied loops and big reductions run on.
+
+   there is one pool per process, started the first time it's needed. each worker
+   keeps a deque of index ranges. a worker splits the range it's on in half, pushes one
+   half for someone else, and keeps going on the other half until it's down to the
+   grain size. idle workers steal the oldest (biggest) range from another worker's deque,
+   and sleep until more is pushed if there's nothing to steal.
+
+   two environment variables are read when the pool starts:
+   VEC_THREADS  number of threads, including the caller. the default is one per
+                processor, 1 runs everything on the calling thread
+   VEC_GRAIN    fewest elements of an implied loop a thread takes on at once. the default
+                is 4096
+
+   parallel work started from inside the pool (a reduction inside a parallel loop, say)
+   runs on the thread that started it, and so does work started by a second thread
+   while the pool is busy. */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* the body of a loop, for indices in [begin, end) */
+typedef void (*vec_range_fn)(void* ctx, int32_t begin, int32_t end);
+
+/* run fn over [0, n) in pieces of at least VEC_GRAIN, and wait for all of them */
+void vec_parallel_for(vec_range_fn fn, void* ctx, int32_t n);
+
+/* the same, with a grain of the caller's choosing */
+void vec_parallel_for_grain(vec_range_fn fn, void* ctx, int32_t n, int32_t grain);
+
+/* number of threads the pool runs on, including the caller */
+int32_t vec_pool_threads(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
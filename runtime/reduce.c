@@ -0,0 +1,65 @@
+#include "reduce.h"
+#include "pool.h"
+
+#include <stddef.h>
+
+/* lists shorter than this aren't worth starting threads for */
+#define THRESHOLD (1 << 16)
+
+/* and no chunk is smaller than this */
+#define MIN_CHUNK (1 << 14)
+
+#define MAX_CHUNKS 64
+
+/* number of independent accumulators per chunk, as in tensor.c */
+#define LANES 16
+
+/* how many pieces to split n elements into */
+static int32_t numChunks(int32_t n)
+{
+    int32_t chunks;
+    if (n < THRESHOLD)
+        return 1;
+    chunks = n / MIN_CHUNK;
+    if (chunks > vec_pool_threads())
+        chunks = vec_pool_threads();
+    return chunks < MAX_CHUNKS ? chunks : MAX_CHUNKS;
+}
+
+#define ADD(a, b) ((a) + (b))
+#define MUL(a, b) ((a) * (b))
+#define AND(a, b) ((a) & (b))
+#define OR(a, b) ((a) | (b))
+#define XOR(a, b) ((a) ^ (b))
+
+#define T int8_t
+#define SUFFIX i8
+#define INTEGER
+#include "reduce.inc"
+
+#define T int16_t
+#define SUFFIX i16
+#define INTEGER
+#include "reduce.inc"
+
+#define T int32_t
+#define SUFFIX i32
+#define INTEGER
+#include "reduce.inc"
+
+#define T int64_t
+#define SUFFIX i64
+#define INTEGER
+#include "reduce.inc"
+
+#define T float
+#define SUFFIX f32
+#include "reduce.inc"
+
+#define T double
+#define SUFFIX f64
+#include "reduce.inc"
+
+#define T long double
+#define SUFFIX f80
+#include "reduce.inc"
@@ -0,0 +1,51 @@
+#ifndef VEC_REDUCE_H
+#define VEC_REDUCE_H
+
+#include <stdint.h>
+
+/* runtime support for aggregating a list with one of the associative built in
+   operations, as in  += `xs.
+
+   vec_reduce_<op>_<type>(data, n, strict) combines the n elements at data. an empty list
+   gives the identity of op (0 for add, or, and xor, 1 for mul, all ones for and).
+
+   big lists are split into chunks which are reduced on the thread pool (see pool.h),
+   and the partial results are combined pairwise. each chunk keeps several partial
+   accumulators, so floating point results depend on the order that works out to. if strict is
+   nonzero, floats are instead added up strictly left to right on the calling thread,
+   which is slower but gives the same answer as a loop would. integers ignore it. */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define VEC_DECLARE_ARITH_REDUCTIONS(T, suffix) \
+    T vec_reduce_add_##suffix(const void* data, int32_t n, int32_t strict); \
+    T vec_reduce_mul_##suffix(const void* data, int32_t n, int32_t strict);
+
+#define VEC_DECLARE_BIT_REDUCTIONS(T, suffix) \
+    T vec_reduce_and_##suffix(const void* data, int32_t n, int32_t strict); \
+    T vec_reduce_or_##suffix(const void* data, int32_t n, int32_t strict); \
+    T vec_reduce_xor_##suffix(const void* data, int32_t n, int32_t strict);
+
+VEC_DECLARE_ARITH_REDUCTIONS(int8_t, i8)
+VEC_DECLARE_ARITH_REDUCTIONS(int16_t, i16)
+VEC_DECLARE_ARITH_REDUCTIONS(int32_t, i32)
+VEC_DECLARE_ARITH_REDUCTIONS(int64_t, i64)
+VEC_DECLARE_ARITH_REDUCTIONS(float, f32)
+VEC_DECLARE_ARITH_REDUCTIONS(double, f64)
+VEC_DECLARE_ARITH_REDUCTIONS(long double, f80)
+
+VEC_DECLARE_BIT_REDUCTIONS(int8_t, i8)
+VEC_DECLARE_BIT_REDUCTIONS(int16_t, i16)
+VEC_DECLARE_BIT_REDUCTIONS(int32_t, i32)
+VEC_DECLARE_BIT_REDUCTIONS(int64_t, i64)
+
+#undef VEC_DECLARE_ARITH_REDUCTIONS
+#undef VEC_DECLARE_BIT_REDUCTIONS
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
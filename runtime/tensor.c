@@ -0,0 +1,81 @@
+#include "tensor.h"
+
+#include <stddef.h>
+
+/* a tensor of any rank */
+typedef struct
+{
+    const char* data;
+    int32_t rank;
+    const int32_t* shape;
+    const int32_t* strides;
+} view;
+
+static view viewOf(const void* t, int32_t rank)
+{
+    view v;
+    v.data = *(const char* const*)t;
+    v.rank = rank;
+    v.shape = (const int32_t*)((const char*)t + sizeof(void*));
+    v.strides = v.shape + rank;
+    return v;
+}
+
+/* the kernels work a row (the last dimension) at a time. these find the rows */
+
+static int32_t numRows(const int32_t* shape, int32_t rank)
+{
+    int32_t rows = 1;
+    int32_t d;
+    for (d = 0; d < rank - 1; ++d)
+        rows *= shape[d];
+    return rows;
+}
+
+/* offset in elements of the start of row */
+static ptrdiff_t rowOffset(const view* v, int32_t row, const int32_t* shape)
+{
+    ptrdiff_t off = 0;
+    int32_t d;
+    for (d = v->rank - 2; d >= 0; --d)
+    {
+        off += (ptrdiff_t)(row % shape[d]) * v->strides[d];
+        row /= shape[d];
+    }
+    return off;
+}
+
+/* number of independent accumulators in a contiguous row. enough to fill a few
+   vector registers, so the compiler can vectorize them and hide the add latency */
+#define LANES 16
+
+/* dot needs the common shape somewhere */
+#define MAX_RANK 64
+
+#define T int8_t
+#define SUFFIX i8
+#include "tensor_reduce.inc"
+
+#define T int16_t
+#define SUFFIX i16
+#include "tensor_reduce.inc"
+
+#define T int32_t
+#define SUFFIX i32
+#include "tensor_reduce.inc"
+
+#define T int64_t
+#define SUFFIX i64
+#include "tensor_reduce.inc"
+
+#define T float
+#define SUFFIX f32
+#include "tensor_reduce.inc"
+
+#define T double
+#define SUFFIX f64
+#include "tensor_reduce.inc"
+
+#define T long double
+#define SUFFIX f80
+#include "tensor_reduce.inc"
@@ -0,0 +1,44 @@
+#ifndef VEC_TENSOR_H
+#define VEC_TENSOR_H
+
+#include <stdint.h>
+
+/* runtime support for vec tensors.
+
+   a tensor of rank r, [T, r], is {T* data, int32_t shape[r], int32_t strides[r]}.
+   strides are in elements, so element (i, j) of a [T, 2] is at
+   data[i * strides[0] + j * strides[1]]. the data isn't owned by the tensor, so host
+   code can describe its own arrays, transposes, and slices of them without copying.
+
+   reductions take the tensor by address along with its rank. the sum of an empty
+   tensor is 0, and so are its min and max. dot works on the part of the shapes that
+   the tensors have in common. */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* the layout of a tensor, for host code */
+#define VEC_TENSOR(T, rank) struct { T* data; int32_t shape[rank]; int32_t strides[rank]; }
+
+#define VEC_DECLARE_REDUCTIONS(T, suffix) \
+    T vec_tensor_sum_##suffix(const void* t, int32_t rank); \
+    T vec_tensor_min_##suffix(const void* t, int32_t rank); \
+    T vec_tensor_max_##suffix(const void* t, int32_t rank); \
+    T vec_tensor_dot_##suffix(const void* a, const void* b, int32_t rank);
+
+VEC_DECLARE_REDUCTIONS(int8_t, i8)
+VEC_DECLARE_REDUCTIONS(int16_t, i16)
+VEC_DECLARE_REDUCTIONS(int32_t, i32)
+VEC_DECLARE_REDUCTIONS(int64_t, i64)
+VEC_DECLARE_REDUCTIONS(float, f32)
+VEC_DECLARE_REDUCTIONS(double, f64)
+VEC_DECLARE_REDUCTIONS(long double, f80)
+
+#undef VEC_DECLARE_REDUCTIONS
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,49 @@
+#!/bin/bash
+#runs every tests/*.vc. each test says how to check itself with "//run:" lines, which are run
+#with bash in a scratch directory holding a copy of the test, after substituting
+#  %vc  the compiler under test
+#  %s   the copy of the test (so dot files and such land in the scratch directory)
+#  %S   this directory, for expected output
+#a test fails if any of its run lines exits non-zero
+#usage: tests/run.sh [path to vc] [tests...]
+
+here=$(cd "$(dirname "$0")" && pwd)
+vc=$(cd "$(dirname "${1:-./vc}")" && pwd)/$(basename "${1:-./vc}")
+shift
+tests=${@:-$here/*.vc}
+
+#strip the color codes from error messages
+nocolor() { sed 's/\x1b\[[0-9;]*m//g'; }
+#number the node pointers in a dot file in the order they appear, so dumps can be diffed
+normdot() { awk '{ while (match($0, /0x[0-9a-f]+/)) { p = substr($0, RSTART, RLENGTH); if (!(p in n)) n[p] = "N" k++; $0 = substr($0, 1, RSTART - 1) n[p] substr($0, RSTART + RLENGTH) } print }' "$@"; }
+export -f nocolor normdot
+
+failed=0
+for t in $tests
+do
+    name=$(basename "$t")
+    dir=$(mktemp -d)
+    cp "$t" "$dir/"
+    ok=1
+    while read -r line
+    do
+        cmd=${line//%vc/$vc}
+        cmd=${cmd//%s/$name}
+        cmd=${cmd//%S/$here}
+        if ! (cd "$dir" && bash -o pipefail -c "$cmd")
+        then
+            echo "$name: failed: $line"
+            ok=0
+            break
+        fi
+    done < <(sed -n 's/^\/\/run: *//p' "$t")
+    rm -rf "$dir"
+    if [ $ok = 1 ]
+    then
+        echo "$name: ok"
+    else
+        failed=$((failed + 1))
+    fi
+done
+
+[ $failed = 0 ] || { echo "$failed test(s) failed"; exit 1; }
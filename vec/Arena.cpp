@@ -0,0 +1,46 @@
+#include "Arena.h"
+
+using namespace utl;
+
+#define CHUNK_SIZE (64 * 1024)
+//enough for anything we put in here, including long double
+#define ARENA_ALIGN 16
+
+THREAD_LOCAL Arena* Arena::current = nullptr;
+bool Arena::heapMode = false;
+
+Arena::Arena()
+    : cur(nullptr), end(nullptr), allocs(0), used(0), reserved(0)
+{}
+
+void* Arena::allocate(size_t size)
+{
+    size = (size + ARENA_ALIGN - 1) & ~size_t(ARENA_ALIGN - 1);
+
+    if (heapMode)
+    {
+        chunks.emplace_back(new char[size]);
+        ++allocs;
+        used += size;
+        reserved += size;
+        return chunks.back().get();
+    }
+
+    if (size_t(end - cur) < size)
+    {
+        //big things get a chunk of their own
+        size_t chunkSize = size > CHUNK_SIZE ? size : CHUNK_SIZE;
+        //new[] of char is only guaranteed to be aligned for fundamental types, but that's
+        //what ARENA_ALIGN is
+        chunks.emplace_back(new char[chunkSize]);
+        cur = chunks.back().get();
+        end = cur + chunkSize;
+        reserved += chunkSize;
+    }
+
+    void* ret = cur;
+    cur += size;
+    ++allocs;
+    used += size;
+    return ret;
+}
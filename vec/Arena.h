@@ -0,0 +1,53 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <vector>
+#include <memory>
+#include <cstddef>
+
+#include "Parallel.h"
+
+namespace utl
+{
+    //bump pointer allocator. nothing is freed until the whole arena dies, so objects
+    //that live in one must not own memory outside of it that their destructors don't free
+    class Arena
+    {
+        std::vector<std::unique_ptr<char[]>> chunks;
+        char* cur;
+        char* end;
+
+        size_t allocs;
+        size_t used;
+        size_t reserved;
+
+    public:
+        Arena();
+
+        void* allocate(size_t size);
+
+        size_t numAllocations() const {return allocs;}
+        size_t bytesUsed() const {return used;}
+        size_t bytesReserved() const {return reserved;}
+
+        //give every allocation its own block from the heap, which is how nodes were
+        //allocated before there were arenas. they're still freed when the arena dies.
+        //only for bench/arena, to have something to compare against
+        static bool heapMode;
+
+        //the arena that new AST nodes are allocated from. see ArenaGuard. each thread has
+        //its own, so modules can be parsed in parallel
+        static THREAD_LOCAL Arena* current;
+    };
+
+    //make an arena current until the end of the scope
+    class ArenaGuard
+    {
+        Arena* old;
+    public:
+        ArenaGuard(Arena& a) : old(Arena::current) {Arena::current = &a;}
+        ~ArenaGuard() {Arena::current = old;}
+    };
+}
+
+#endif
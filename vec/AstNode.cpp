@@ -45,12 +45,18 @@ class Annotation
         : type(typ::error),
         address(nullptr)
     {}
+
+public:
+    //live in the same arena as the node
+    static void* operator new(size_t size, utl::Arena& a) {return a.allocate(size);}
+    static void operator delete(void*, utl::Arena&) {}
+    static void operator delete(void*) {}
 };
 
 void Node0::makeAnnot()
 {
     if (!Annot())
-        Annot().reset(new Annotation());
+        Annot().reset(new (*arena) Annotation());
 }
 
 void Node0::Annotate(const val::Value& v)
@@ -94,6 +100,22 @@ llvm::Value* Node0::Address()
     return Annot() ? Annot()->address : nullptr;
 }
 
+bool Node0::ownAnnot(typ::Type& t, val::Value& v)
+{
+    if (!annot)
+        return false;
+    t = annot->type;
+    v = annot->value;
+    return true;
+}
+
+void Node0::setOwnAnnot(typ::Type t, const val::Value& v)
+{
+    if (!annot)
+        annot.reset(new (*arena) Annotation());
+    annot->set(t, v);
+}
+
 void Node0::preExec(sa::Exec&)
 {
     //no, it might not need to do anything
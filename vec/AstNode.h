@@ -3,6 +3,7 @@
 
 #include "Token.h"
 #include "Type.h"
+#include "Arena.h"
 
 #include <functional>
 #include <ostream>
@@ -77,12 +78,99 @@ namespace ast
     */
     //alternatively, we could use template magic to make this all work.
 
+    //every concrete node class has a kind, so casts can compare integers instead of typeids.
+    //subclasses come right after the class they derive from, so "is a T or derived from
+    //T" is a range check. keep it that way when adding nodes (and update KindRange)
+    enum class NodeKind : unsigned char
+    {
+        none, //not looked up yet, see Node0::Kind
+
+        Module,
+
+        NullExpr,
+        VarExpr,
+            DeclExpr,
+                IntrinDeclExpr,
+        Lambda,
+        ConstExpr,
+        AssignExpr,
+            OpAssignExpr,
+        OverloadCallExpr,
+            TupAccExpr,
+            ListAccExpr,
+        IterExpr,
+        AggExpr,
+        ListifyExpr,
+        TuplifyExpr,
+        PostExpr,
+
+        NullStmt,
+        ExprStmt,
+        StmtPair,
+        Block,
+        IfStmt,
+        IfElseStmt,
+        SwitchStmt,
+        WhileStmt,
+        ReturnStmt,
+
+        TmpExpr,
+        RhoStmt,
+        BranchStmt,
+        PhiExpr,
+        ImpliedLoopStmt,
+        IntrinCallExpr,
+        ArithCast,
+    };
+
+    //kinds that are a T. only classes with subclasses need to specialize this
+    template<class T>
+    struct KindRange
+    {
+        static const NodeKind first = T::kind;
+        static const NodeKind last = T::kind;
+    };
+
+    struct VarExpr;
+    struct DeclExpr;
+    struct AssignExpr;
+    struct OverloadCallExpr;
+
+    template<> struct KindRange<VarExpr>
+    {
+        static const NodeKind first = NodeKind::VarExpr;
+        static const NodeKind last = NodeKind::IntrinDeclExpr;
+    };
+
+    template<> struct KindRange<DeclExpr>
+    {
+        static const NodeKind first = NodeKind::DeclExpr;
+        static const NodeKind last = NodeKind::IntrinDeclExpr;
+    };
+
+    template<> struct KindRange<AssignExpr>
+    {
+        static const NodeKind first = NodeKind::AssignExpr;
+        static const NodeKind last = NodeKind::OpAssignExpr;
+    };
+
+    template<> struct KindRange<OverloadCallExpr>
+    {
+        static const NodeKind first = NodeKind::OverloadCallExpr;
+        static const NodeKind last = NodeKind::ListAccExpr;
+    };
+
+    //all nodes are allocated from the arena of the module they belong to (which is
+    //utl::Arena::current when they're created). deleting a node runs its destructor
+    //but gives back no memory; the memory goes away with the module.
+
     //virtual Node base class for generic node classes ie expr, stmt
     class Node0
     {
     protected:
         Node0(tok::Location const &l)
-            : llvmVal(nullptr), loc(l), parent(nullptr) {}
+            : llvmVal(nullptr), arena(utl::Arena::current), nodeKind(NodeKind::none),
+            loc(l), parent(nullptr) {}
         virtual ~Node0() {};
         friend struct deleter;
 
@@ -123,15 +211,36 @@ namespace ast
     protected:
         typedef std::unique_ptr<Annotation, AnnotDeleter> annot_t;
         llvm::Value* llvmVal; //used in some cases to break recursion cycles
+        utl::Arena* arena; //where this node and its annotation live
 
     private:
         annot_t annot;
+        NodeKind nodeKind; //cached myKind()
 
         //this allows memoization of the value so it can be accessed again
         virtual llvm::Value* generate(cg::CodeGen&);
 
     public:
 
+        static void* operator new(size_t size)
+        {
+            assert(utl::Arena::current && "no arena for AST node");
+            return utl::Arena::current->allocate(size);
+        }
+        static void operator delete(void*) {} //the arena owns the memory
+
+        utl::Arena& getArena() {return *arena;}
+
+        //each concrete class returns its kind. use Kind() instead, it only makes the
+        //virtual call once per node
+        virtual NodeKind myKind() = 0;
+        NodeKind Kind()
+        {
+            if (nodeKind == NodeKind::none)
+                nodeKind = myKind();
+            return nodeKind;
+        }
+
         //so TempExprs can share an annotation
         virtual annot_t& Annot() {return annot;}
 
@@ -145,8 +254,15 @@ namespace ast
         val::Value& Value();
         llvm::Value* Address();
 
+        //the annotation this node owns, even if Annot() forwards to another node's. for the
+        //module cache. ownAnnot returns false if there isn't one
+        bool ownAnnot(typ::Type& t, val::Value& v);
+        void setOwnAnnot(typ::Type t, const val::Value& v);
+
         virtual void preExec(sa::Exec&);
         llvm::Value* gen(cg::CodeGen&);
+        //forget what gen() returned, so the next call generates the node again
+        void resetGen() {llvmVal = nullptr;}
 
         tok::Location loc; //might not be set
         Node0 *parent;
@@ -202,6 +318,30 @@ namespace ast
     };
 
     //ast node from which all others are derived
+    //exact_cast for nodes. see Util.h
+    template<class To>
+    To exact_node_cast(Node0* from)
+    {
+        typedef typename std::remove_pointer<To>::type T;
+        if (from != nullptr && from->Kind() == T::kind)
+            return static_cast<To>(from);
+        else
+            return nullptr;
+    }
+
+    //dynamic_cast for nodes
+    template<class To>
+    To node_cast(Node0* from)
+    {
+        typedef typename std::remove_pointer<To>::type T;
+        if (from != nullptr
+            && from->Kind() >= KindRange<T>::first
+            && from->Kind() <= KindRange<T>::last)
+            return static_cast<To>(from);
+        else
+            return nullptr;
+    }
+
     class Node1 : public Node0
     {
         Ptr a;
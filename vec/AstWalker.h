@@ -135,7 +135,7 @@ namespace sa
     template<class filter, class c, class o>
     filter* Subtree<filter, c, o>::Iterator::doCast(Cast::Dynamic)
     {
-        return dynamic_cast<filter*>(n);
+        return ast::node_cast<filter*>(n);
     }
     
     //all unspecialized functions
@@ -4,62 +4,899 @@
 #include "Value.h"
 #include "Global.h"
 #include "Error.h"
+#include "Intrinsic.h"
+#include "Parallel.h"
 
 #include <set>
+#include <map>
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <cstdio>
+#include <cerrno>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#include <sys/wait.h>
+#endif
 
 using namespace cg;
 using namespace llvm;
 
 #define IGNORED nullptr //denotes an llvm::Value* that should be ignored
+#define RUN_ENTRY "__vec_run" //see genRunEntry
 
 //IMPORTANT: the order of evaluation of function arguments is not specified.
 //DO NOT CALL GENERATE IN AN ARGUMENT LIST. BAD THINGS WILL HAPPEN.
 
+//optimization levels:
+//-O0 only promotes variables to registers, so the IR is easy to read
+//-O1 cleans up each function and vectorizes implied loops
+//-O2 inlines, and adds GVN, LICM, and the rest of the usual scalar and loop passes
+//-O3 inlines more and unrolls loops
+namespace
+{
+    //run on each function first, so the inliner sees them already cleaned up
+    void addFunctionPasses(FunctionPassManager& fpm, int level)
+    {
+        //every variable starts out as an alloca
+        fpm.add(createPromoteMemoryToRegisterPass());
+        fpm.add(createCFGSimplificationPass());
+        if (level == 0)
+            return;
+
+        fpm.add(createTypeBasedAliasAnalysisPass());
+        fpm.add(createBasicAliasAnalysisPass());
+        fpm.add(createSROAPass());
+        fpm.add(createEarlyCSEPass());
+        fpm.add(createInstructionCombiningPass());
+    }
+
+    void addModulePasses(PassManager& pm, int level)
+    {
+        if (level == 0)
+            return;
+
+        pm.add(createTypeBasedAliasAnalysisPass());
+        pm.add(createBasicAliasAnalysisPass());
+
+        if (level >= 2)
+        {
+            pm.add(createGlobalOptimizerPass());
+            pm.add(createIPSCCPPass());
+            pm.add(createFunctionInliningPass(level >= 3 ? 275 : 225));
+            pm.add(createFunctionAttrsPass());
+            if (level >= 3)
+                pm.add(createArgumentPromotionPass());
+
+            //what inlining exposed
+            pm.add(createSROAPass());
+            pm.add(createEarlyCSEPass());
+            pm.add(createInstructionCombiningPass());
+            pm.add(createCFGSimplificationPass());
+            pm.add(createReassociatePass());
+
+            pm.add(createLoopRotatePass());
+            pm.add(createLICMPass());
+            pm.add(createLoopUnswitchPass());
+            pm.add(createInstructionCombiningPass());
+            pm.add(createIndVarSimplifyPass());
+            pm.add(createLoopDeletionPass());
+            if (level >= 3)
+                pm.add(createLoopUnrollPass());
+
+            pm.add(createGVNPass());
+            pm.add(createMemCpyOptPass());
+            pm.add(createDeadStoreEliminationPass());
+            pm.add(createAggressiveDCEPass());
+            pm.add(createCFGSimplificationPass());
+            pm.add(createInstructionCombiningPass());
+        }
+
+        //implied loops are set up for these
+        pm.add(createLoopVectorizePass());
+        pm.add(createSLPVectorizerPass());
+        pm.add(createInstructionCombiningPass());
+        pm.add(createCFGSimplificationPass());
+        if (level >= 2)
+        {
+            pm.add(createLICMPass()); //runtime checks the vectorizer added
+            pm.add(createGlobalDCEPass());
+        }
+    }
+}
+
+//-emit=obj and exe, and --run. the code generator for the machine we're running on
+namespace
+{
+    CodeGenOpt::Level codeGenLevel(int level)
+    {
+        static const CodeGenOpt::Level levels[] = {CodeGenOpt::None, CodeGenOpt::Less,
+            CodeGenOpt::Default, CodeGenOpt::Aggressive};
+        return levels[level];
+    }
+
+    TargetMachine* hostMachine(int level)
+    {
+        InitializeNativeTarget();
+        InitializeNativeTargetAsmPrinter();
+
+        std::string triple = sys::getDefaultTargetTriple();
+        std::string errors;
+        const Target* target = TargetRegistry::lookupTarget(triple, errors);
+        if (!target)
+        {
+            err::Error(err::fatal, tok::Location()) << "cannot generate code for " << triple
+                << ": " << errors;
+            throw err::FatalError();
+        }
+
+        //position independent, so it links into anything
+        return target->createTargetMachine(triple, sys::getHostCPUName(), "", TargetOptions(),
+            Reloc::PIC_, CodeModel::Default, codeGenLevel(level));
+    }
+
+    void openOutput(std::unique_ptr<raw_fd_ostream>& out, const std::string& path)
+    {
+        std::string errors;
+        out.reset(new raw_fd_ostream(path.c_str(), errors, raw_fd_ostream::F_Binary));
+        if (!errors.empty())
+        {
+            err::Error(err::fatal, tok::Location()) << "cannot write " << path << ": " << errors;
+            throw err::FatalError();
+        }
+    }
+
+    void emitObject(Module& mod, TargetMachine& machine, raw_fd_ostream& out)
+    {
+        PassManager emitter;
+        emitter.add(new DataLayout(*machine.getDataLayout()));
+        formatted_raw_ostream fout(out);
+        if (machine.addPassesToEmitFile(emitter, fout, TargetMachine::CGFT_ObjectFile))
+        {
+            err::Error(err::fatal, tok::Location()) << "cannot write object files for "
+                << machine.getTargetTriple().str();
+            throw err::FatalError();
+        }
+        emitter.run(mod);
+    }
+
+#ifdef _WIN32
+    //_spawnvp joins its arguments with spaces, so each one is quoted the way the c
+    //runtime splits them up again
+    std::string quoteArg(const std::string& arg)
+    {
+        std::string ret = "\"";
+        size_t slashes = 0;
+        for (char c : arg)
+        {
+            if (c == '\\')
+                ++slashes;
+            else
+            {
+                if (c == '"')
+                    ret.append(slashes + 1, '\\');
+                slashes = 0;
+            }
+            ret += c;
+        }
+        ret.append(slashes, '\\');
+        return ret + '"';
+    }
+#endif
+
+    //run a program found on the path, without a shell in between. true if it exits with 0
+    bool runProgram(const std::vector<std::string>& args)
+    {
+#ifdef _WIN32
+        std::vector<std::string> quoted;
+        for (auto& arg : args)
+            quoted.push_back(quoteArg(arg));
+        std::vector<const char*> argv;
+        for (auto& arg : quoted)
+            argv.push_back(arg.c_str());
+        argv.push_back(nullptr);
+        return _spawnvp(_P_WAIT, args[0].c_str(), argv.data()) == 0;
+#else
+        //made before forking, the child should only exec
+        std::vector<char*> argv;
+        for (auto& arg : args)
+            argv.push_back(const_cast<char*>(arg.c_str()));
+        argv.push_back(nullptr);
+
+        pid_t pid = fork();
+        if (pid < 0)
+            return false;
+        if (pid == 0)
+        {
+            execvp(argv[0], argv.data());
+            _exit(127);
+        }
+
+        int status;
+        while (waitpid(pid, &status, 0) < 0)
+            if (errno != EINTR)
+                return false;
+        return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+#endif
+    }
+
+    //the directory vc is running from, or the current one if there's no telling
+    std::string exeDir()
+    {
+#ifdef _WIN32
+        char* path = nullptr;
+        if (_get_pgmptr(&path) != 0 || !path || !*path)
+            return ".";
+        std::string exe = path;
+        size_t slash = exe.find_last_of("\\/");
+#else
+        char path[4096];
+        ssize_t len = readlink("/proc/self/exe", path, sizeof(path));
+        if (len <= 0 || size_t(len) == sizeof(path))
+            return ".";
+        std::string exe(path, len);
+        size_t slash = exe.rfind('/');
+#endif
+        return slash == std::string::npos ? "." : exe.substr(0, slash);
+    }
+
+    //link objs with the runtime library, libvecrt.a (vecrt.lib on windows), which the
+    //makefile puts next to vc. it's looked for in $VEC_RUNTIME, or vc's own directory.
+    //the compiler driver is $CC, or the system's
+    void link(const std::vector<std::string>& objs, const std::string& exe)
+    {
+        const char* dir = getenv("VEC_RUNTIME");
+        const char* cc = getenv("CC");
+        std::string rt = dir ? dir : exeDir();
+
+        std::vector<std::string> args;
+#ifdef _WIN32
+        args.push_back(cc ? cc : "cl");
+        args.push_back("/nologo");
+        args.push_back("/Fe" + exe);
+        args.insert(args.end(), objs.begin(), objs.end());
+        args.push_back(rt + "\\vecrt.lib");
+#else
+        args.push_back(cc ? cc : "cc");
+        args.push_back("-o");
+        args.push_back(exe);
+        args.insert(args.end(), objs.begin(), objs.end());
+        args.push_back(rt + "/libvecrt.a");
+        args.push_back("-lpthread");
+        args.push_back("-lm");
+#endif
+
+        if (!runProgram(args))
+        {
+            std::string cmd;
+            for (auto& arg : args)
+                cmd += ' ' + arg;
+            err::Error(err::fatal, tok::Location()) << "linking failed:" << cmd;
+            throw err::FatalError();
+        }
+        for (auto& obj : objs)
+            remove(obj.c_str());
+    }
+}
+
+//-j. the functions are split up into pieces, each optimized (and for -emit=exe, compiled)
+//on a thread of its own in a context of its own, since a context can only be used by one
+//thread at a time. making the ir stays on one thread, because it annotates the ast.
+//a piece has copies of everything its functions call, so they can still be inlined.
+//the pieces don't depend on how many threads there are, so neither does the output
+namespace
+{
+    //the function passes on every function with a body, then the module passes
+    void optimize(Module& mod, int level)
+    {
+        FunctionPassManager fpm(&mod);
+        addFunctionPasses(fpm, level);
+        fpm.doInitialization();
+        for (auto& f : mod)
+            if (!f.isDeclaration())
+                fpm.run(f);
+        fpm.doFinalization();
+
+        PassManager pm;
+        addModulePasses(pm, level);
+        pm.run(mod);
+    }
+
+    void verify(Module& mod)
+    {
+        if (verifyModule(mod, llvm::VerifierFailureAction::PrintMessageAction))
+        {
+            err::Error(err::fatal, tok::Location()) << "generated code is invalid";
+            throw err::FatalError();
+        }
+    }
+
+    typedef std::set<const Function*> Group;
+
+    //one group for each external function with a body, in module order. internal ones
+    //(parallel loop bodies) go wherever they're used
+    std::vector<Group> split(const Module& mod)
+    {
+        std::vector<Group> groups;
+        for (auto& f : mod)
+            if (!f.isDeclaration() && !f.hasLocalLinkage())
+            {
+                groups.push_back(Group());
+                groups.back().insert(&f);
+            }
+        return groups;
+    }
+
+    //add the functions v refers to, looking inside constants, so a function that's only
+    //used through a cast (like a parallel loop body) is still found
+    void reach(const llvm::Value* v, Group& reached, std::vector<const Function*>& todo)
+    {
+        if (const Function* f = dyn_cast<Function>(v))
+        {
+            if (reached.insert(f).second)
+                todo.push_back(f);
+        }
+        else if (isa<Constant>(v) && !isa<GlobalValue>(v))
+        {
+            const Constant* c = cast<Constant>(v);
+            for (unsigned i = 0; i < c->getNumOperands(); ++i)
+                reach(c->getOperand(i), reached, todo);
+        }
+    }
+
+    //a copy of mod that only defines the functions in group. everything they can reach is
+    //kept, available_externally (or internal, if it was), and the rest become declarations.
+    //only the first piece keeps the external global variables, the rest declare them
+    void makePiece(const Module& mod, const Group& group, bool first, std::string& bitcode)
+    {
+        Group reached(group);
+        std::vector<const Function*> todo(group.begin(), group.end());
+        while (!todo.empty())
+        {
+            const Function* f = todo.back();
+            todo.pop_back();
+            for (auto& bb : *f)
+                for (auto& inst : bb)
+                    for (unsigned i = 0; i < inst.getNumOperands(); ++i)
+                        reach(inst.getOperand(i), reached, todo);
+        }
+
+        std::unique_ptr<Module> piece(CloneModule(&mod));
+        std::vector<Function*> dropped;
+        for (auto& orig : mod)
+        {
+            if (orig.isDeclaration() || group.count(&orig))
+                continue;
+
+            Function* f = piece->getFunction(orig.getName());
+            if (!reached.count(&orig))
+            {
+                f->deleteBody();
+                if (orig.hasLocalLinkage())
+                    dropped.push_back(f);
+            }
+            else if (!orig.hasLocalLinkage())
+                f->setLinkage(GlobalValue::AvailableExternallyLinkage);
+        }
+
+        //deleteBody made these external declarations, and nothing left refers to them
+        for (auto f : dropped)
+            if (f->use_empty())
+                f->eraseFromParent();
+
+        //otherwise every piece would define them
+        if (!first)
+            for (auto& gv : piece->getGlobalList())
+                if (!gv.isDeclaration() && !gv.hasLocalLinkage())
+                {
+                    gv.setInitializer(nullptr);
+                    gv.setLinkage(GlobalValue::ExternalLinkage);
+                }
+
+        raw_string_ostream out(bitcode);
+        WriteBitcodeToFile(piece.get(), out);
+        out.flush();
+    }
+
+    Module* readBitcode(const std::string& bitcode, LLVMContext& ctx)
+    {
+        std::unique_ptr<MemoryBuffer> buf(MemoryBuffer::getMemBuffer(bitcode, "", false));
+        std::string errors;
+        Module* mod = ParseBitcodeFile(buf.get(), ctx, &errors);
+        if (!mod)
+        {
+            err::Error(err::fatal, tok::Location()) << "cannot read generated code back: "
+                << errors;
+            throw err::FatalError();
+        }
+        return mod;
+    }
+
+    //optimize each group in a piece of its own, on -j threads. if objects isn't null, each
+    //piece is compiled to <out>.<n>.o and the paths go in objects. otherwise the pieces are
+    //linked back together into a new module, which is returned
+    Module* optimizePieces(const Module& mod, const std::vector<Group>& groups, int level,
+        const std::string& out, std::vector<std::string>* objects)
+    {
+        //this uses mod's context, so it can't be spread out
+        std::vector<std::string> bitcode(groups.size());
+        for (size_t i = 0; i < groups.size(); ++i)
+            makePiece(mod, groups[i], i == 0, bitcode[i]);
+
+        if (objects)
+            for (size_t i = 0; i < groups.size(); ++i)
+                objects->push_back(out + '.' + utl::to_str(i) + ".o");
+
+        //the native target is already initialized, by whoever made mod's target machine
+        llvm_start_multithreaded();
+        utl::parallelFor(groups.size(), Global().options.jobs, [&] (size_t i)
+        {
+            LLVMContext ctx;
+            std::unique_ptr<Module> piece(readBitcode(bitcode[i], ctx));
+            optimize(*piece, level);
+            verify(*piece);
+
+            if (objects)
+            {
+                std::unique_ptr<TargetMachine> machine(hostMachine(level));
+                std::unique_ptr<raw_fd_ostream> file;
+                openOutput(file, (*objects)[i]);
+                emitObject(*piece, *machine, *file);
+                return;
+            }
+
+            bitcode[i].clear();
+            raw_string_ostream os(bitcode[i]);
+            WriteBitcodeToFile(piece.get(), os);
+            os.flush();
+        });
+
+        if (objects)
+            return nullptr;
+
+        std::unique_ptr<Module> linked(new Module(mod.getModuleIdentifier(), mod.getContext()));
+        linked->setTargetTriple(mod.getTargetTriple());
+        linked->setDataLayout(mod.getDataLayout());
+        for (auto& bc : bitcode)
+        {
+            std::string errors;
+            if (Linker::LinkModules(linked.get(), readBitcode(bc, mod.getContext()),
+                Linker::DestroySource, &errors))
+            {
+                err::Error(err::fatal, tok::Location()) << "cannot put generated code back together: "
+                    << errors;
+                throw err::FatalError();
+            }
+        }
+        return linked.release();
+    }
+}
+
 CodeGen::CodeGen(std::string& outfile)
-    : curBB(nullptr), curFunc(nullptr)
+    : curBB(nullptr), curFunc(nullptr), curIdx(nullptr)
 {
     if (Global().numErrors != 0) //cannot generate code if there are errors
     {
-        err::Error(err::fatal, tok::Location()) << Global().numErrors << " errors have occured";
+        err::Error(err::fatal, tok::Location()) << Global().numErrors.load() << " errors have occured";
         throw err::FatalError();
     }
 
     curMod.reset(new Module(outfile + ".bc", getGlobalContext()));
 
-    Global().entryPt->Value().getFunc()->gen(*this);
+    int level = Global().options.optLevel;
+    GlobalData::Emit emit = Global().options.emit;
+    bool run = Global().options.run;
+    bool native = emit == GlobalData::EMIT_OBJ || emit == GlobalData::EMIT_EXE || run;
+
+    //the optimizers want to know what they're optimizing for
+    std::unique_ptr<TargetMachine> machine;
+    if (native)
+    {
+        machine.reset(hostMachine(level));
+        curMod->setTargetTriple(machine->getTargetTriple());
+        curMod->setDataLayout(machine->getDataLayout()->getStringRepresentation());
+    }
+
+    //main, then everything it calls, and everything they call...
+    Function* entry = function(Global().entryPt->Value().getFunc().get());
+    while (!worklist.empty())
+    {
+        ast::Lambda* fn = worklist.front();
+        worklist.pop();
+        fn->gen(*this);
+    }
+    if (run)
+        genRunEntry(entry);
+
+    //the jit wants everything in one module, and without -j it's optimized whole
+    std::vector<Group> groups;
+    if (!run && Global().options.jobs)
+        groups = split(*curMod);
+    Global().codegenPieces = groups.size() > 1 ? groups.size() : 1;
+
+    if (groups.size() > 1 && emit == GlobalData::EMIT_EXE)
+    {
+        std::vector<std::string> objects;
+        optimizePieces(*curMod, groups, level, outfile, &objects);
+        link(objects, outfile);
+        return;
+    }
+
+    if (groups.size() > 1)
+        curMod.reset(optimizePieces(*curMod, groups, level, outfile, nullptr));
+    else
+        optimize(*curMod, level);
+
+    //assembly is written even if it's broken, so it can be looked at
+    if (emit == GlobalData::EMIT_LL && !run)
+    {
+        std::unique_ptr<raw_fd_ostream> out;
+        openOutput(out, outfile);
+        PassManager pm;
+        pm.add(createPrintModulePass(out.get()));
+        pm.add(createVerifierPass(llvm::VerifierFailureAction::PrintMessageAction));
+        pm.run(*curMod);
+        return;
+    }
+
+    verify(*curMod);
+
+    //the module stays in memory for jit()
+    if (run)
+        return;
+
+    std::string path = emit == GlobalData::EMIT_EXE ? outfile + ".o" : outfile;
+    std::unique_ptr<raw_fd_ostream> out;
+    openOutput(out, path);
+
+    if (emit == GlobalData::EMIT_BC)
+    {
+        WriteBitcodeToFile(curMod.get(), *out);
+        return;
+    }
+
+    emitObject(*curMod, *machine, *out);
+    out.reset(); //flush it before the linker reads it
+
+    if (emit == GlobalData::EMIT_EXE)
+        link(std::vector<std::string>(1, path), outfile);
+}
+
+//the entry point's arguments depend on how main was declared, so give the jit something
+//with a known signature to call. main gets zeros (no command line), and whatever it
+//returns is the exit code if it's an integer
+void CodeGen::genRunEntry(llvm::Function* entry)
+{
+    LLVMContext& ctx = getGlobalContext();
+    llvm::Type* int_t = llvm::Type::getInt32Ty(ctx);
+
+    Function* run = Function::Create(llvm::FunctionType::get(int_t, false),
+        llvm::GlobalValue::ExternalLinkage, RUN_ENTRY, curMod.get());
+    BasicBlock* bb = BasicBlock::Create(ctx, "", run);
+
+    std::vector<llvm::Value*> args;
+    for (Function::arg_iterator a = entry->arg_begin(); a != entry->arg_end(); ++a)
+        args.push_back(Constant::getNullValue(a->getType()));
+    llvm::Value* ret = CallInst::Create(entry, args, "", bb);
+
+    if (ret->getType()->isIntegerTy())
+        ret = CastInst::CreateIntegerCast(ret, int_t, true, "", bb);
+    else
+        ret = ConstantInt::get(int_t, 0);
+    ReturnInst::Create(ctx, ret, bb);
+}
+
+CodeGen::RunEntry CodeGen::jit()
+{
+    assert(Global().options.run && "the module wasn't generated for --run");
+
+    //the runtime library is linked into the compiler, so its functions are found among
+    //our own symbols
+    sys::DynamicLibrary::LoadLibraryPermanently(nullptr);
 
     std::string errors;
-    llvm::raw_fd_ostream fout(outfile.c_str(), errors);
+    engine.reset(EngineBuilder(curMod.release())
+        .setEngineKind(EngineKind::JIT)
+        .setOptLevel(codeGenLevel(Global().options.optLevel))
+        .setErrorStr(&errors)
+        .create());
+    if (!engine)
+    {
+        err::Error(err::fatal, tok::Location()) << "cannot start the jit: " << errors;
+        throw err::FatalError();
+    }
+
+    //compile everything now, so it isn't counted as run time
+    engine->DisableLazyCompilation(true);
+    void* run = engine->getPointerToFunction(engine->FindFunctionNamed(RUN_ENTRY));
+    return reinterpret_cast<RunEntry>(reinterpret_cast<intptr_t>(run));
+}
+
+Function* CodeGen::function(ast::Lambda* fn)
+{
+    Function*& f = functions[fn];
+    if (!f)
+    {
+        //overloads get numbered by llvm, since they all have the same name
+        f = Function::Create(cast<llvm::FunctionType>(fn->Type().toLLVM()),
+            llvm::GlobalValue::ExternalLinkage, llvm::StringRef(fn->name), curMod.get());
+        worklist.push(fn);
+    }
+    return f;
+}
+
+llvm::Value* CodeGen::entryAlloca(llvm::Type* t)
+{
+    BasicBlock& entry = curFunc->getEntryBlock();
+    if (entry.empty())
+        return new AllocaInst(t, "", &entry);
+    return new AllocaInst(t, "", &entry.front());
+}
+
+llvm::Value* CodeGen::stackCopy(llvm::Value* v)
+{
+    llvm::Value* addr = entryAlloca(v->getType());
+    new StoreInst(v, addr, curBB);
+    return addr;
+}
+
+//---------------------------------------------------
+//lists
+
+llvm::Value* CodeGen::listLength(llvm::Value* list)
+{
+    if (ArrayType* arr = dyn_cast<ArrayType>(list->getType()))
+        return ConstantInt::get(llvm::Type::getInt32Ty(getGlobalContext()), arr->getNumElements());
+    return ExtractValueInst::Create(list, LIST_LEN, "", curBB);
+}
+
+llvm::Value* CodeGen::listData(ast::Node0* n, llvm::Value* list)
+{
+    if (!isa<ArrayType>(list->getType()))
+        return ExtractValueInst::Create(list, LIST_DATA, "", curBB);
+
+    //index into the array where it lives. if it's a temporary, give it somewhere to live
+    llvm::Value* addr = n->Address();
+    if (!addr)
+    {
+        addr = stackCopy(list);
+        n->Annotate(addr);
+    }
+
+    llvm::Value* zero = ConstantInt::get(llvm::Type::getInt32Ty(getGlobalContext()), 0);
+    llvm::Value* idxs[] = {zero, zero};
+    return GetElementPtrInst::Create(addr, idxs, "", curBB);
+}
+
+//---------------------------------------------------
+//runtime library
+
+Function* CodeGen::runtimeFunc(const char* name, unsigned numPtrs, unsigned numInts,
+    llvm::Type* ret)
+{
+    Function* f = curMod->getFunction(name);
+    if (f)
+        return f;
+
+    LLVMContext& ctx = getGlobalContext();
+    std::vector<llvm::Type*> args(numPtrs, llvm::Type::getInt8PtrTy(ctx));
+    args.resize(numPtrs + numInts, llvm::Type::getInt32Ty(ctx));
+
+    return Function::Create(
+        llvm::FunctionType::get(ret ? ret : llvm::Type::getVoidTy(ctx), args, false),
+        llvm::GlobalValue::ExternalLinkage, name, curMod.get());
+}
+
+namespace
+{
+    llvm::Value* opaque(llvm::Value* ptr, BasicBlock* bb)
+    {
+        return new BitCastInst(ptr, llvm::Type::getInt8PtrTy(getGlobalContext()), "", bb);
+    }
+
+    llvm::Constant* sizeOf(llvm::Type* t)
+    {
+        return ConstantExpr::getTruncOrBitCast(ConstantExpr::getSizeOf(t),
+            llvm::Type::getInt32Ty(getGlobalContext()));
+    }
+}
+
+void CodeGen::listReserve(llvm::Value* list, llvm::Value* len, llvm::Type* elem)
+{
+    llvm::Value* args[] = {opaque(list, curBB), len, sizeOf(elem)};
+    CallInst::Create(runtimeFunc("vec_list_reserve", 1, 2), args, "", curBB);
+}
+
+void CodeGen::listAppend(llvm::Value* list, llvm::Value* src, llvm::Value* n, llvm::Type* elem)
+{
+    llvm::Value* args[] = {opaque(list, curBB), opaque(src, curBB), n, sizeOf(elem)};
+    CallInst::Create(runtimeFunc("vec_list_append", 2, 2), args, "", curBB);
+}
+
+void CodeGen::listConcat(llvm::Value* out, llvm::Value* l, llvm::Value* r, llvm::Type* elem)
+{
+    llvm::Value* args[] = {opaque(out, curBB), opaque(l, curBB), opaque(r, curBB), sizeOf(elem)};
+    CallInst::Create(runtimeFunc("vec_list_concat", 3, 1), args, "", curBB);
+}
+
+void CodeGen::listFree(llvm::Value* list)
+{
+    CallInst::Create(runtimeFunc("vec_list_free", 1, 0), opaque(list, curBB), "", curBB);
+}
+
+bool CodeGen::ownsList(ast::Node0* n)
+{
+    while (ast::TmpExpr* tmp = exact_cast<ast::TmpExpr*>(n))
+        n = tmp->setBy;
+    ast::VarExpr* var = ast::node_cast<ast::VarExpr*>(n);
+    if (!var)
+        return false;
+    ast::DeclExpr* decl = ast::node_cast<ast::DeclExpr*>(var);
+    return ownedLists.count(decl ? decl : var->sco->getVarDef(var->Name())) != 0;
+}
+
+namespace
+{
+    //the runtime's name for an element type
+    std::string kernelSuffix(llvm::Type* elem)
+    {
+        if (elem->isIntegerTy())
+            return "i" + utl::to_str(elem->getIntegerBitWidth());
+        if (elem->isFloatTy())
+            return "f32";
+        if (elem->isDoubleTy())
+            return "f64";
+        assert(elem->isX86_FP80Ty() && "no kernel for that type");
+        return "f80";
+    }
+}
+
+llvm::Value* CodeGen::tensorReduce(const char* op, std::vector<llvm::Value*>& tensors,
+    unsigned rank, llvm::Type* elem)
+{
+    std::string name = std::string("vec_tensor_") + op + "_" + kernelSuffix(elem);
 
-	PassManager pm;
-    //pm.add(createDeadCodeEliminationPass());
-    //add a few passes to make the IR easier to read
-    pm.add(createCFGSimplificationPass());
-    //pm.add(createGVNPass());
-	pm.add(createPrintModulePass(&fout));
-    pm.add(createVerifierPass(llvm::VerifierFailureAction::PrintMessageAction));
-	pm.run(*curMod);
+    std::vector<llvm::Value*> args;
+    for (auto t : tensors)
+        args.push_back(opaque(stackCopy(t), curBB));
+    args.push_back(ConstantInt::get(llvm::Type::getInt32Ty(getGlobalContext()), rank));
+
+    Function* kernel = runtimeFunc(name.c_str(), tensors.size(), 1, elem);
+    return CallInst::Create(kernel, args, "", curBB);
+}
+
+llvm::Value* CodeGen::listReduce(const char* op, llvm::Value* data, llvm::Value* len,
+    llvm::Type* elem)
+{
+    std::string name = std::string("vec_reduce_") + op + "_" + kernelSuffix(elem);
+    llvm::Type* int_t = llvm::Type::getInt32Ty(getGlobalContext());
+
+    llvm::Value* args[] = {opaque(data, curBB), len,
+        ConstantInt::get(int_t, Global().options.strictFP)};
+    return CallInst::Create(runtimeFunc(name.c_str(), 1, 2, elem), args, "", curBB);
+}
+
+void CodeGen::parallelFor(llvm::Function* body, llvm::Value* ctx, llvm::Value* n)
+{
+    llvm::Value* args[] = {opaque(body, curBB), opaque(ctx, curBB), n};
+    CallInst::Create(runtimeFunc("vec_parallel_for", 2, 1), args, "", curBB);
 }
 
 //---------------------------------------------------
 //control flow nodes
 
-Value* ast::Lambda::generate(CodeGen& cgen)
+namespace
 {
-    //TODO: name mangling?
+    bool isConcat(ast::Node0* n)
+    {
+        ast::IntrinCallExpr* call = exact_cast<ast::IntrinCallExpr*>(n);
+        return call && call->intrin_id >= intr::OPS::CONCAT && call->intrin_id < intr::OPS::SUBSCRIPT;
+    }
 
-    //get or create function
-    cgen.curFunc = cgen.curMod->getFunction(Global().getIdent(name));
+    //whether n only looks at the elements of the list it names, rather than copying the
+    //list itself somewhere
+    bool elementUse(ast::Node0* n)
+    {
+        ast::Node0* p = n->parent;
+        if (exact_cast<ast::IterExpr*>(p))
+            return true;
+
+        //the list side of a $ is copied, the element side is the list itself
+        ast::IntrinCallExpr* call = exact_cast<ast::IntrinCallExpr*>(p);
+        if (!call)
+            return false;
+        switch (call->intrin_id - intr::OPS::CONCAT)
+        {
+        case 0:
+            return true;
+        case 1:
+            return call->getChild(1) == n;
+        case 2:
+        case 3: //subscript
+            return call->getChild(0) == n;
+        default:
+            return false;
+        }
+    }
+
+    //a list variable owns its data if it's a local that only ever gets new lists from $,
+    //and that's never copied anywhere as a whole. any other list could be sharing its
+    //data, so growing or freeing it would leave the other one pointing at freed memory
+    bool isOwned(ast::DeclExpr* decl, ast::Lambda* fn)
+    {
+        typ::ListType list = decl->Type().getList();
+        if (!list.isValid() || list.length())
+            return false;
+        //parameters are declared at the top of the body, but the caller has their data
+        if (decl->sco == fn->sco
+            && std::find(fn->params.begin(), fn->params.end(), decl->Name()) != fn->params.end())
+            return false;
+
+        for (auto n : sa::Subtree<>(fn->getChildA()))
+        {
+            //x $= y reads and writes x through temporaries set by a lone x
+            ast::Node0* var = n;
+            while (ast::TmpExpr* tmp = exact_cast<ast::TmpExpr*>(var))
+                var = tmp->setBy;
+            if (!ast::node_cast<ast::VarExpr*>(var) || &var->Annot() != &decl->Annot())
+                continue;
+
+            ast::AssignExpr* asgn = exact_cast<ast::AssignExpr*>(n->parent);
+            if (asgn && asgn->getChildA() == n)
+            {
+                if (!isConcat(asgn->getChildB()))
+                    return false;
+            }
+            else if (n == var && exact_cast<ast::StmtPair*>(n->parent))
+                continue; //a declaration, or the x the temporaries are set by
+            else if (!elementUse(n))
+                return false;
+        }
+        return true;
+    }
+}
+
+Value* ast::Lambda::generate(CodeGen& cgen)
+{
+    cgen.curFunc = cgen.function(this);
 
-    if (!cgen.curFunc)
+    //their declarations at the top of the body pick these up
+    cgen.params.clear();
+    assert(params.size() == cgen.curFunc->arg_size() && "Exec checked the parameters");
+    Function::arg_iterator arg = cgen.curFunc->arg_begin();
+    for (auto param : params)
     {
-        cgen.curFunc = Function::Create(
-            dyn_cast<llvm::FunctionType>(Type().toLLVM()),
-            llvm::GlobalValue::ExternalLinkage, Global().getIdent(name), cgen.curMod.get());
+        arg->setName(llvm::StringRef(param));
+        cgen.params[sco->getVarDef(param)] = arg++;
     }
 
+    std::set<DeclExpr*> outerOwned;
+    std::swap(cgen.ownedLists, outerOwned);
+    for (auto decl : sa::Subtree<DeclExpr>(getChildA()))
+        if (isOwned(decl, this))
+            cgen.ownedLists.insert(decl);
+
     getChildA()->gen(cgen);
 
+    //free the owned lists on the way out. they all start out empty in the entry block, so
+    //this is fine even on paths that never got to their declarations
+    for (auto& bb : *cgen.curFunc)
+    {
+        ReturnInst* ret = dyn_cast<ReturnInst>(bb.getTerminator());
+        if (!ret)
+            continue;
+        ret->removeFromParent();
+        cgen.curBB = &bb;
+        for (auto decl : cgen.ownedLists)
+            if (decl->Address())
+                cgen.listFree(decl->Address());
+        bb.getInstList().push_back(ret);
+    }
+
+    std::swap(cgen.ownedLists, outerOwned);
     return cgen.curFunc;
 }
 
@@ -125,6 +962,589 @@ Value* ast::PhiExpr::generate(CodeGen& cgen)
     return ret;
 }
 
+//implied loops are strip mined by the number of elements of the widest list that fit in a
+//vector register. each strip emits the body once per element so the SLP vectorizer can
+//turn them into vector ops
+#define VECTOR_BITS 128
+
+namespace
+{
+    //llvm.vectorizer.width or .unroll, the loop vectorizer's hints in 3.3. it has no hint to
+    //turn it on, it tries every loop
+    MDNode* loopHint(const char* name, unsigned val)
+    {
+        LLVMContext& ctx = getGlobalContext();
+        llvm::Value* ops[] = {MDString::get(ctx, name),
+            ConstantInt::get(llvm::Type::getInt32Ty(ctx), val)};
+        return MDNode::get(ctx, ops);
+    }
+
+    //the llvm.loop node refers to itself so that it's distinct from every other loop's
+    MDNode* loopID(MDNode* hint)
+    {
+        LLVMContext& ctx = getGlobalContext();
+        MDNode* temp = MDNode::getTemporary(ctx, ArrayRef<llvm::Value*>());
+        llvm::Value* ops[] = {temp, hint};
+        MDNode* id = MDNode::get(ctx, ops);
+        id->replaceOperandWith(0, id);
+        MDNode::deleteTemporary(temp);
+        return id;
+    }
+
+    //so the body of an implied loop can be emitted again for the next element. the lists
+    //are generated once before the loop, so leave them alone
+    void forgetGenerated(ast::Node0* n)
+    {
+        n->resetGen();
+        if (exact_cast<ast::IterExpr*>(n))
+            return;
+        for (ast::Node0* c = n->childAfter(nullptr); c; c = n->childAfter(c))
+            forgetGenerated(c);
+    }
+
+    llvm::Value* genLoopBody(ast::Node0* body, llvm::Value* idx, CodeGen& cgen)
+    {
+        cgen.curIdx = idx;
+        forgetGenerated(body);
+        return body->gen(cgen);
+    }
+
+    llvm::Value* smaller(llvm::Value* l, llvm::Value* r, CodeGen& cgen)
+    {
+        llvm::Value* less = CmpInst::Create(Instruction::OtherOps::ICmp,
+            CmpInst::Predicate::ICMP_SLT, l, r, "", cgen.curBB);
+        return SelectInst::Create(less, l, r, "", cgen.curBB);
+    }
+
+    struct CountedLoop
+    {
+        PHINode* i;
+        llvm::Value* step;
+        BasicBlock* head;
+        BasicBlock* exit;
+    };
+
+    //for (i = begin; i < end; i += step). leaves cgen in the body
+    CountedLoop beginLoop(llvm::Value* begin, llvm::Value* end, llvm::Value* step, CodeGen& cgen)
+    {
+        LLVMContext& ctx = getGlobalContext();
+        CountedLoop l;
+        l.step = step;
+
+        BasicBlock* preheader = cgen.curBB;
+        l.head = BasicBlock::Create(ctx, "", cgen.curFunc);
+        BasicBlock* body = BasicBlock::Create(ctx, "", cgen.curFunc);
+        l.exit = BasicBlock::Create(ctx, "", cgen.curFunc);
+        BranchInst::Create(l.head, preheader);
+
+        l.i = PHINode::Create(begin->getType(), 2, "", l.head);
+        l.i->addIncoming(begin, preheader);
+        llvm::Value* more = CmpInst::Create(Instruction::OtherOps::ICmp,
+            CmpInst::Predicate::ICMP_SLT, l.i, end, "", l.head);
+        BranchInst::Create(body, l.exit, more, l.head);
+
+        cgen.curBB = body;
+        return l;
+    }
+
+    //returns the latch
+    BranchInst* endLoop(CountedLoop& l, CodeGen& cgen)
+    {
+        l.i->addIncoming(BinaryOperator::Create(Instruction::BinaryOps::Add,
+            l.i, l.step, "", cgen.curBB), cgen.curBB);
+        BranchInst* latch = BranchInst::Create(l.head, cgen.curBB);
+        cgen.curBB = l.exit;
+        return latch;
+    }
+}
+
+//tensors get a loop nest, outer dimensions first. the last two dimensions are tiled so
+//that when the tensors are laid out differently (one is a transpose of another, say) a
+//tile of each still fits in cache. the innermost loop is left for the loop vectorizer
+#define TENSOR_TILE 32
+
+static void genTensorNest(ast::ImpliedLoopStmt* il, CodeGen& cgen)
+{
+    llvm::Type* idx_t = llvm::Type::getInt32Ty(getGlobalContext());
+    llvm::Value* zero = ConstantInt::get(idx_t, 0);
+    llvm::Value* one = ConstantInt::get(idx_t, 1);
+    llvm::Value* tile = ConstantInt::get(idx_t, TENSOR_TILE);
+
+    //preExec made sure they all have the same rank
+    unsigned rank = il->targets.front()->getChildA()->Type().getTensor().rank();
+    std::vector<llvm::Value*> shape(rank, nullptr);
+    for (auto t : il->targets)
+    {
+        llvm::Value* tensor = t->getChildA()->gen(cgen);
+        for (unsigned d = 0; d < rank; ++d)
+        {
+            unsigned field[] = {TENSOR_SHAPE, d};
+            llvm::Value* len = ExtractValueInst::Create(tensor, field, "", cgen.curBB);
+            shape[d] = shape[d] ? smaller(shape[d], len, cgen) : len;
+        }
+    }
+
+    std::vector<CountedLoop> loops;
+    cgen.tensorIdx.assign(rank, nullptr);
+    unsigned untiled = rank >= 2 ? rank - 2 : rank;
+    for (unsigned d = 0; d < untiled; ++d)
+    {
+        loops.push_back(beginLoop(zero, shape[d], one, cgen));
+        cgen.tensorIdx[d] = loops.back().i;
+    }
+
+    if (untiled < rank)
+    {
+        unsigned a = rank - 2, b = rank - 1;
+        loops.push_back(beginLoop(zero, shape[a], tile, cgen));
+        PHINode* tileA = loops.back().i;
+        loops.push_back(beginLoop(zero, shape[b], tile, cgen));
+        PHINode* tileB = loops.back().i;
+
+        llvm::Value* endA = smaller(BinaryOperator::Create(Instruction::BinaryOps::Add,
+            tileA, tile, "", cgen.curBB), shape[a], cgen);
+        llvm::Value* endB = smaller(BinaryOperator::Create(Instruction::BinaryOps::Add,
+            tileB, tile, "", cgen.curBB), shape[b], cgen);
+
+        loops.push_back(beginLoop(tileA, endA, one, cgen));
+        cgen.tensorIdx[a] = loops.back().i;
+        loops.push_back(beginLoop(tileB, endB, one, cgen));
+        cgen.tensorIdx[b] = loops.back().i;
+    }
+
+    forgetGenerated(il->getChildA());
+    il->getChildA()->gen(cgen);
+
+    endLoop(loops.back(), cgen);
+    loops.pop_back();
+    while (!loops.empty())
+    {
+        endLoop(loops.back(), cgen);
+        loops.pop_back();
+    }
+
+    cgen.tensorIdx.clear();
+}
+
+//         i = begin
+// strips: while (i + VF <= end)
+//             body(i), body(i + 1), ... body(i + VF - 1)
+//             i += VF
+// rest:   while (i < end)
+//             body(i)
+//             ++i
+static void genStrips(ast::ImpliedLoopStmt* il, llvm::Value* begin, llvm::Value* end,
+    unsigned vf, CodeGen& cgen)
+{
+    LLVMContext& ctx = getGlobalContext();
+    llvm::Type* idx_t = llvm::Type::getInt32Ty(ctx);
+
+    BasicBlock* preheader = cgen.curBB;
+    BasicBlock* stripHead = BasicBlock::Create(ctx, "strips", cgen.curFunc);
+    BasicBlock* stripBody = BasicBlock::Create(ctx, "", cgen.curFunc);
+    BasicBlock* restHead = BasicBlock::Create(ctx, "rest", cgen.curFunc);
+    BasicBlock* restBody = BasicBlock::Create(ctx, "", cgen.curFunc);
+    BasicBlock* exit = BasicBlock::Create(ctx, "", cgen.curFunc);
+    BranchInst::Create(stripHead, preheader);
+
+    //strips of vf elements
+    PHINode* i = PHINode::Create(idx_t, 2, "", stripHead);
+    i->addIncoming(begin, preheader);
+    llvm::Value* stripEnd = BinaryOperator::Create(Instruction::BinaryOps::Add,
+        i, ConstantInt::get(idx_t, vf), "", stripHead);
+    llvm::Value* haveStrip = CmpInst::Create(Instruction::OtherOps::ICmp,
+        CmpInst::Predicate::ICMP_SLE, stripEnd, end, "", stripHead);
+    BranchInst::Create(stripBody, restHead, haveStrip, stripHead);
+
+    cgen.curBB = stripBody;
+    for (unsigned lane = 0; lane < vf; ++lane)
+    {
+        llvm::Value* idx = lane == 0 ? (llvm::Value*)i
+            : BinaryOperator::Create(Instruction::BinaryOps::Add,
+                i, ConstantInt::get(idx_t, lane), "", cgen.curBB);
+        genLoopBody(il->getChildA(), idx, cgen);
+    }
+    i->addIncoming(stripEnd, cgen.curBB);
+    //the lanes are already there for SLP, but the loop vectorizer may still interleave strips
+    BranchInst::Create(stripHead, cgen.curBB);
+
+    //whatever's left, one at a time
+    PHINode* j = PHINode::Create(idx_t, 2, "", restHead);
+    j->addIncoming(i, stripHead);
+    llvm::Value* haveElem = CmpInst::Create(Instruction::OtherOps::ICmp,
+        CmpInst::Predicate::ICMP_SLT, j, end, "", restHead);
+    BranchInst::Create(restBody, exit, haveElem, restHead);
+
+    cgen.curBB = restBody;
+    genLoopBody(il->getChildA(), j, cgen);
+    j->addIncoming(BinaryOperator::Create(Instruction::BinaryOps::Add,
+        j, ConstantInt::get(idx_t, 1), "", cgen.curBB), cgen.curBB);
+    //fewer than vf iterations, so vectorizing it can't pay off
+    BranchInst::Create(restHead, cgen.curBB)->setMetadata("llvm.loop",
+        loopID(loopHint("llvm.vectorizer.width", 1)));
+
+    cgen.curBB = exit;
+}
+
+//the body goes in a function of its own, void f(i8* ctx, i32 begin, i32 end), which the
+//thread pool calls on pieces of the lists. it can't see this function's frame, so ctx
+//holds the address of every variable the body uses
+static void genParallel(ast::ImpliedLoopStmt* il, llvm::Value* len, unsigned vf, CodeGen& cgen)
+{
+    LLVMContext& ctx = getGlobalContext();
+    llvm::Type* idx_t = llvm::Type::getInt32Ty(ctx);
+    llvm::Value* zero = ConstantInt::get(idx_t, 0);
+
+    std::vector<ast::Node0*> vars; //one for each address
+    std::vector<llvm::Value*> addrs;
+    std::vector<llvm::Type*> fields;
+    std::set<llvm::Value*> seen;
+    for (auto n : sa::Subtree<>(il->getChildA()))
+    {
+        if (!ast::node_cast<ast::VarExpr*>(n) || !n->Address() || !seen.insert(n->Address()).second)
+            continue;
+        vars.push_back(n);
+        addrs.push_back(n->Address());
+        fields.push_back(n->Address()->getType());
+    }
+
+    StructType* ctxType = StructType::get(ctx, fields);
+    llvm::Value* ctxAddr = cgen.entryAlloca(ctxType);
+    for (unsigned f = 0; f < addrs.size(); ++f)
+    {
+        llvm::Value* idxs[] = {zero, ConstantInt::get(idx_t, f)};
+        new StoreInst(addrs[f], GetElementPtrInst::Create(ctxAddr, idxs, "", cgen.curBB), cgen.curBB);
+    }
+
+    llvm::Type* params[] = {llvm::Type::getInt8PtrTy(ctx), idx_t, idx_t};
+    Function* body = Function::Create(
+        llvm::FunctionType::get(llvm::Type::getVoidTy(ctx), params, false),
+        llvm::GlobalValue::InternalLinkage, cgen.curFunc->getName() + ".par", cgen.curMod.get());
+
+    Function* outerFunc = cgen.curFunc;
+    BasicBlock* outerBB = cgen.curBB;
+    cgen.curFunc = body;
+    cgen.curBB = BasicBlock::Create(ctx, "", body);
+
+    Function::arg_iterator arg = body->arg_begin();
+    llvm::Value* ctxArg = new BitCastInst(arg++, PointerType::getUnqual(ctxType), "", cgen.curBB);
+    llvm::Value* begin = arg++;
+    llvm::Value* end = arg;
+    for (unsigned f = 0; f < vars.size(); ++f)
+    {
+        llvm::Value* idxs[] = {zero, ConstantInt::get(idx_t, f)};
+        vars[f]->Annotate(new LoadInst(
+            GetElementPtrInst::Create(ctxArg, idxs, "", cgen.curBB), "", cgen.curBB));
+    }
+
+    //markParallelLoops only allows variables as targets, so loading them again is cheap
+    for (auto t : il->targets)
+    {
+        t->getChildA()->resetGen();
+        t->getChildA()->gen(cgen);
+    }
+
+    genStrips(il, begin, end, vf, cgen);
+    ReturnInst::Create(ctx, cgen.curBB);
+
+    //back out here
+    for (unsigned f = 0; f < vars.size(); ++f)
+        vars[f]->Annotate(addrs[f]);
+    for (auto t : il->targets)
+        t->getChildA()->resetGen();
+    cgen.curFunc = outerFunc;
+    cgen.curBB = outerBB;
+
+    cgen.parallelFor(body, ctxAddr, len);
+}
+
+//n = min(length of each list), then the strips from 0 to n. with --parallel the strips
+//are split up between threads
+Value* ast::ImpliedLoopStmt::generate(CodeGen& cgen)
+{
+    if (targets.front()->getChildA()->Type().getTensor().isValid())
+    {
+        genTensorNest(this, cgen);
+        return IGNORED;
+    }
+
+    LLVMContext& ctx = getGlobalContext();
+    llvm::Type* idx_t = llvm::Type::getInt32Ty(ctx);
+
+    llvm::Value* len = nullptr;
+    unsigned widest = 8;
+    bool allPrimitive = true;
+    for (auto t : targets)
+    {
+        llvm::Value* list = t->getChildA()->gen(cgen);
+        llvm::Value* tlen = cgen.listLength(list);
+        //so a temporary array gets its home outside the loop
+        cgen.listData(t->getChildA(), list);
+        if (len)
+        {
+            llvm::Value* shorter = CmpInst::Create(Instruction::OtherOps::ICmp,
+                CmpInst::Predicate::ICMP_SLT, tlen, len, "", cgen.curBB);
+            len = SelectInst::Create(shorter, tlen, len, "", cgen.curBB);
+        }
+        else
+            len = tlen;
+
+        unsigned bits = t->Type().toLLVM()->getPrimitiveSizeInBits();
+        if (bits == 0)
+            allPrimitive = false;
+        widest = std::max(widest, bits);
+    }
+
+    //don't bother strip mining lists of structures
+    unsigned vf = allPrimitive ? std::max(VECTOR_BITS / widest, 1u) : 1;
+
+    //x $= `y appends the same number of elements to x every time around, so make room
+    //for all of them first and the appends don't have to check. anything else that
+    //assigns x could change its capacity, so leave those alone
+    struct Appends {unsigned count; llvm::Type* elem;};
+    std::map<llvm::Value*, Appends> appends;
+    std::set<llvm::Value*> clobbered;
+    for (auto asgn : sa::Subtree<AssignExpr>(getChildA()))
+    {
+        llvm::Value* addr = asgn->Address();
+        if (!addr)
+            continue;
+        IntrinCallExpr* call = exact_cast<IntrinCallExpr*>(asgn->getChildB());
+        if (call && call->intrin_id == intr::OPS::CONCAT + 2 && call->appendTarget()
+            && cgen.ownsList(call->appendTarget()))
+        {
+            Appends& a = appends[addr];
+            ++a.count;
+            a.elem = call->getChild(1)->Type().toLLVM();
+        }
+        else
+            clobbered.insert(addr);
+    }
+
+    for (auto& a : appends)
+    {
+        if (clobbered.count(a.first))
+            continue;
+        llvm::Value* list = new LoadInst(a.first, "", cgen.curBB);
+        llvm::Value* need = BinaryOperator::Create(Instruction::BinaryOps::Mul,
+            len, ConstantInt::get(idx_t, a.second.count), "", cgen.curBB);
+        need = BinaryOperator::Create(Instruction::BinaryOps::Add,
+            ExtractValueInst::Create(list, LIST_LEN, "", cgen.curBB), need, "", cgen.curBB);
+        cgen.listReserve(a.first, need, a.second.elem);
+        cgen.presized.insert(a.first);
+    }
+
+    if (parallel)
+        genParallel(this, len, vf, cgen);
+    else
+        genStrips(this, ConstantInt::get(idx_t, 0), len, vf, cgen);
+
+    cgen.curIdx = nullptr;
+    for (auto& a : appends)
+        cgen.presized.erase(a.first);
+    return IGNORED;
+}
+
+//reductions the lanes can be split up for, and what each lane starts with
+namespace
+{
+    bool isAssociative(Instruction::BinaryOps op)
+    {
+        switch (op)
+        {
+        case Instruction::BinaryOps::Add: case Instruction::BinaryOps::FAdd:
+        case Instruction::BinaryOps::Mul: case Instruction::BinaryOps::FMul:
+        case Instruction::BinaryOps::And: case Instruction::BinaryOps::Or:
+        case Instruction::BinaryOps::Xor:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    llvm::Constant* identity(Instruction::BinaryOps op, llvm::Type* t)
+    {
+        switch (op)
+        {
+        case Instruction::BinaryOps::Mul: return ConstantInt::get(t, 1);
+        case Instruction::BinaryOps::FMul: return ConstantFP::get(t, 1.);
+        case Instruction::BinaryOps::And: return Constant::getAllOnesValue(t);
+        default: return Constant::getNullValue(t);
+        }
+    }
+
+    //name of the runtime kernel for op
+    const char* reduceKernel(Instruction::BinaryOps op)
+    {
+        switch (op)
+        {
+        case Instruction::BinaryOps::Add: case Instruction::BinaryOps::FAdd: return "add";
+        case Instruction::BinaryOps::Mul: case Instruction::BinaryOps::FMul: return "mul";
+        case Instruction::BinaryOps::And: return "and";
+        case Instruction::BinaryOps::Or: return "or";
+        default: return "xor";
+        }
+    }
+
+    //      n = min(length of each list)
+    //      acc = body(0), i = 1
+    // loop: while (i < n)
+    //          acc = acc op body(i)
+    //          ++i
+    //      result = n > 0 ? acc : identity of op
+    llvm::Value* orderedFold(ast::AggExpr* agg, Instruction::BinaryOps op, llvm::Value* len,
+        CodeGen& cgen)
+    {
+        LLVMContext& ctx = getGlobalContext();
+        llvm::Type* idx_t = llvm::Type::getInt32Ty(ctx);
+        llvm::Type* elem = agg->Type().toLLVM();
+
+        BasicBlock* preheader = cgen.curBB;
+        BasicBlock* first = BasicBlock::Create(ctx, "", cgen.curFunc);
+        BasicBlock* done = BasicBlock::Create(ctx, "", cgen.curFunc);
+        llvm::Value* nonEmpty = CmpInst::Create(Instruction::OtherOps::ICmp,
+            CmpInst::Predicate::ICMP_SGT, len, ConstantInt::get(idx_t, 0), "", cgen.curBB);
+        BranchInst::Create(first, done, nonEmpty, cgen.curBB);
+
+        cgen.curBB = first;
+        llvm::Value* init = genLoopBody(agg->getChildA(), ConstantInt::get(idx_t, 0), cgen);
+        BasicBlock* entry = cgen.curBB;
+
+        CountedLoop l = beginLoop(ConstantInt::get(idx_t, 1), len, ConstantInt::get(idx_t, 1), cgen);
+        PHINode* acc = PHINode::Create(elem, 2, "", &l.head->front());
+        acc->addIncoming(init, entry);
+        llvm::Value* next = BinaryOperator::Create(op,
+            acc, genLoopBody(agg->getChildA(), l.i, cgen), "", cgen.curBB);
+        acc->addIncoming(next, cgen.curBB);
+        endLoop(l, cgen);
+        BranchInst::Create(done, cgen.curBB);
+
+        PHINode* result = PHINode::Create(elem, 2, "", done);
+        result->addIncoming(identity(op, elem), preheader);
+        result->addIncoming(acc, cgen.curBB);
+        cgen.curBB = done;
+        return result;
+    }
+
+    //like an implied loop, but each lane of a strip has its own accumulator. they're
+    //combined pairwise after the strips and the rest are folded in one at a time
+    llvm::Value* laneFold(ast::AggExpr* agg, Instruction::BinaryOps op, llvm::Value* len,
+        CodeGen& cgen)
+    {
+        LLVMContext& ctx = getGlobalContext();
+        llvm::Type* idx_t = llvm::Type::getInt32Ty(ctx);
+        llvm::Type* elem = agg->Type().toLLVM();
+        unsigned bits = elem->getPrimitiveSizeInBits();
+        unsigned vf = std::max(VECTOR_BITS / std::max(bits, 8u), 1u);
+
+        BasicBlock* preheader = cgen.curBB;
+        BasicBlock* stripHead = BasicBlock::Create(ctx, "strips", cgen.curFunc);
+        BasicBlock* stripBody = BasicBlock::Create(ctx, "", cgen.curFunc);
+        BasicBlock* combine = BasicBlock::Create(ctx, "", cgen.curFunc);
+        BasicBlock* restHead = BasicBlock::Create(ctx, "rest", cgen.curFunc);
+        BasicBlock* restBody = BasicBlock::Create(ctx, "", cgen.curFunc);
+        BasicBlock* exit = BasicBlock::Create(ctx, "", cgen.curFunc);
+        BranchInst::Create(stripHead, preheader);
+
+        PHINode* i = PHINode::Create(idx_t, 2, "", stripHead);
+        i->addIncoming(ConstantInt::get(idx_t, 0), preheader);
+        std::vector<PHINode*> accs;
+        for (unsigned lane = 0; lane < vf; ++lane)
+        {
+            accs.push_back(PHINode::Create(elem, 2, "", stripHead));
+            accs.back()->addIncoming(identity(op, elem), preheader);
+        }
+        llvm::Value* stripEnd = BinaryOperator::Create(Instruction::BinaryOps::Add,
+            i, ConstantInt::get(idx_t, vf), "", stripHead);
+        llvm::Value* haveStrip = CmpInst::Create(Instruction::OtherOps::ICmp,
+            CmpInst::Predicate::ICMP_SLE, stripEnd, len, "", stripHead);
+        BranchInst::Create(stripBody, combine, haveStrip, stripHead);
+
+        cgen.curBB = stripBody;
+        std::vector<llvm::Value*> next(vf);
+        for (unsigned lane = 0; lane < vf; ++lane)
+        {
+            llvm::Value* idx = lane == 0 ? (llvm::Value*)i
+                : BinaryOperator::Create(Instruction::BinaryOps::Add,
+                    i, ConstantInt::get(idx_t, lane), "", cgen.curBB);
+            llvm::Value* val = genLoopBody(agg->getChildA(), idx, cgen);
+            next[lane] = BinaryOperator::Create(op, accs[lane], val, "", cgen.curBB);
+        }
+        i->addIncoming(stripEnd, cgen.curBB);
+        for (unsigned lane = 0; lane < vf; ++lane)
+            accs[lane]->addIncoming(next[lane], cgen.curBB);
+        BranchInst::Create(stripHead, cgen.curBB);
+
+        //vf is a power of two
+        std::vector<llvm::Value*> partial(accs.begin(), accs.end());
+        for (unsigned width = vf / 2; width > 0; width /= 2)
+            for (unsigned lane = 0; lane < width; ++lane)
+                partial[lane] = BinaryOperator::Create(op,
+                    partial[lane], partial[lane + width], "", combine);
+        BranchInst::Create(restHead, combine);
+
+        PHINode* j = PHINode::Create(idx_t, 2, "", restHead);
+        j->addIncoming(i, combine);
+        PHINode* acc = PHINode::Create(elem, 2, "", restHead);
+        acc->addIncoming(partial[0], combine);
+        llvm::Value* haveElem = CmpInst::Create(Instruction::OtherOps::ICmp,
+            CmpInst::Predicate::ICMP_SLT, j, len, "", restHead);
+        BranchInst::Create(restBody, exit, haveElem, restHead);
+
+        cgen.curBB = restBody;
+        llvm::Value* val = genLoopBody(agg->getChildA(), j, cgen);
+        acc->addIncoming(BinaryOperator::Create(op, acc, val, "", cgen.curBB), cgen.curBB);
+        j->addIncoming(BinaryOperator::Create(Instruction::BinaryOps::Add,
+            j, ConstantInt::get(idx_t, 1), "", cgen.curBB), cgen.curBB);
+        BranchInst::Create(restHead, cgen.curBB)->setMetadata("llvm.loop",
+            loopID(loopHint("llvm.vectorizer.width", 1)));
+
+        cgen.curBB = exit;
+        return acc;
+    }
+}
+
+//+= `xs just hands the list to the runtime, which splits big ones up between threads.
+//anything else gets a loop here. reassociating float math changes the answer, so
+//--strict-fp folds floats strictly left to right
+Value* ast::AggExpr::generate(CodeGen& cgen)
+{
+    //an aggregate inside an implied loop has its own index
+    llvm::Value* outerIdx = cgen.curIdx;
+    std::vector<llvm::Value*> outerTensorIdx;
+    std::swap(outerTensorIdx, cgen.tensorIdx);
+
+    llvm::Value* len = nullptr;
+    llvm::Value* data = nullptr;
+    for (auto t : targets)
+    {
+        llvm::Value* list = t->getChildA()->gen(cgen);
+        llvm::Value* tlen = cgen.listLength(list);
+        data = cgen.listData(t->getChildA(), list);
+        len = len ? smaller(len, tlen, cgen) : tlen;
+    }
+
+    Instruction::BinaryOps op;
+    bool known = arithOp(combineOp, op);
+    assert(known && "preExec only allows arithmetic");
+    (void)known;
+
+    llvm::Type* elem = Type().toLLVM();
+    bool strict = Global().options.strictFP && elem->isFloatingPointTy();
+
+    llvm::Value* ret;
+    if (getChildA() == targets.front() && targets.size() == 1 && isAssociative(op))
+        ret = cgen.listReduce(reduceKernel(op), data, len, elem);
+    else if (isAssociative(op) && !strict)
+        ret = laneFold(this, op, len, cgen);
+    else
+        ret = orderedFold(this, op, len, cgen);
+
+    cgen.curIdx = outerIdx;
+    std::swap(outerTensorIdx, cgen.tensorIdx);
+    return ret;
+}
+
 Value* ast::TmpExpr::generate(CodeGen& cgen)
 {
     return setBy->gen(cgen);
@@ -143,11 +1563,66 @@ Value* ast::NullStmt::generate(CodeGen&)
     return IGNORED;
 }
 
+Value* ast::IterExpr::generate(CodeGen& cgen)
+{
+    //the list was generated before the loop, so this just picks out its data
+    llvm::Value* list = getChildA()->gen(cgen);
+    llvm::Value* addr;
+    if (!cgen.tensorIdx.empty())
+    {
+        //sum of index * stride for each dimension
+        llvm::Value* offset = nullptr;
+        for (unsigned d = 0; d < cgen.tensorIdx.size(); ++d)
+        {
+            unsigned field[] = {TENSOR_STRIDES, d};
+            llvm::Value* stride = ExtractValueInst::Create(list, field, "", cgen.curBB);
+            llvm::Value* part = BinaryOperator::Create(Instruction::BinaryOps::Mul,
+                cgen.tensorIdx[d], stride, "", cgen.curBB);
+            offset = offset ? BinaryOperator::Create(Instruction::BinaryOps::Add,
+                offset, part, "", cgen.curBB) : part;
+        }
+        llvm::Value* data = ExtractValueInst::Create(list, TENSOR_DATA, "", cgen.curBB);
+        addr = GetElementPtrInst::Create(data, offset, "", cgen.curBB);
+    }
+    else
+        addr = GetElementPtrInst::Create(cgen.listData(getChildA(), list), cgen.curIdx, "", cgen.curBB);
+    Annotate(addr); //so elements can be assigned to
+    return new LoadInst(addr, "", cgen.curBB);
+}
+
 Value* ast::DeclExpr::generate(CodeGen& cgen)
 {
-    llvm::Value* addr = new AllocaInst(Type().toLLVM(), Global().getIdent(Name()), cgen.curBB);
+    if (cgen.ownedLists.count(this))
+    {
+        //it has to be empty wherever the function returns from, see Lambda::generate. if
+        //we come back around to the declaration, the last time's list is garbage
+        llvm::Value* addr = cgen.entryAlloca(Type().toLLVM());
+        addr->setName(llvm::StringRef(Name()));
+        llvm::Constant* empty = Constant::getNullValue(Type().toLLVM());
+        if (Instruction* next = cast<Instruction>(addr)->getNextNode())
+            new StoreInst(empty, addr, next);
+        else
+            new StoreInst(empty, addr, cast<Instruction>(addr)->getParent());
+        Annotate(addr);
+        cgen.listFree(addr);
+        return new LoadInst(addr, "", cgen.curBB);
+    }
+
+    llvm::Value* addr = new AllocaInst(Type().toLLVM(), llvm::StringRef(Name()), cgen.curBB);
     Annotate(addr);
-    //TODO: call constructor
+
+    //TODO: call constructor. for now everything starts zeroed, which is an empty list
+    llvm::Value* init = Constant::getNullValue(Type().toLLVM());
+    //except parameters, which start out as their arguments. fixed length lists are passed
+    //by address
+    auto param = cgen.params.find(this);
+    if (param != cgen.params.end())
+    {
+        init = param->second;
+        if (init->getType() != Type().toLLVM())
+            init = new LoadInst(init, "", cgen.curBB);
+    }
+    new StoreInst(init, addr, cgen.curBB);
 
     //FIXME: this probably will make lots of extra loads. separate decl and var exprs in sema
     //is this even useful ever?
@@ -188,12 +1663,37 @@ Value* ast::AssignExpr::generate(CodeGen& cgen)
     llvm::Value* addr = getChildA()->Address();
     Annotate(addr); //because assignments are lvalues
 
+    //an owned list's old data is garbage now, unless the new list was built in place in it
+    IntrinCallExpr* call = exact_cast<IntrinCallExpr*>(getChildB());
+    if (cgen.ownsList(getChildA()) && !(call && call->appendTarget()))
+        cgen.listFree(addr);
+
     new StoreInst(val, addr, cgen.curBB);
     //TODO: copy constructor
 
     return val;
 }
 
+Value* ast::OverloadCallExpr::generate(CodeGen& cgen)
+{
+    //intrinsics were already turned into IntrinCallExprs
+    assert(ovrResult && ovrResult->Value() && "calls through function values aren't implemented");
+    Function* callee = cgen.function(ovrResult->Value().getFunc().get());
+
+    //one child for each parameter, Sema1 spread the {...} out
+    std::vector<llvm::Value*> args;
+    for (auto& arg : Children())
+        args.push_back(arg->gen(cgen));
+    assert(args.size() == callee->arg_size() && "Exec checked the arguments");
+
+    //fixed length lists are passed by address, of a copy the callee can change
+    for (auto& arg : args)
+        if (isa<ArrayType>(arg->getType()))
+            arg = cgen.stackCopy(arg);
+
+    return CallInst::Create(callee, args, "", cgen.curBB);
+}
+
 Value* ast::ArithCast::generate(CodeGen& cgen)
 {
     llvm::Value* arg = getChildA()->gen(cgen);
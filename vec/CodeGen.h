@@ -3,16 +3,107 @@
 
 #include "LLVM.h"
 
+#include <set>
+#include <map>
+#include <queue>
+#include <vector>
+
+namespace ast
+{
+    struct Node0;
+    struct DeclExpr;
+    struct Lambda;
+}
+
 namespace cg
 {
+    //fields of a variable length list. see runtime/list.h
+    //fixed length lists are just arrays
+    enum ListField
+    {
+        LIST_DATA, //T*, aligned to VEC_LIST_ALIGN
+        LIST_LEN, //int!32
+        LIST_CAP //int!32. 0 if the data isn't ours to grow or free
+    };
+
+    //the instruction for an arithmetic intrinsic, if it is one
+    bool arithOp(int intrin_id, llvm::Instruction::BinaryOps& op);
+
+    //fields of a tensor. see runtime/tensor.h
+    enum TensorField
+    {
+        TENSOR_DATA, //T*
+        TENSOR_SHAPE, //[rank x int!32]
+        TENSOR_STRIDES //[rank x int!32], in elements
+    };
+
     struct CodeGen
     {
         //for now, all code goes into one file
         CodeGen(std::string& outfile);
 
+        //--run. compile the module in memory and return its entry point, which calls main
+        typedef int (*RunEntry)();
+        RunEntry jit();
+
         llvm::BasicBlock* curBB;
         llvm::Function* curFunc;
+        llvm::Value* curIdx; //index of the element the current implied loop is on
+        std::vector<llvm::Value*> tensorIdx; //same thing for loops over tensors
         std::unique_ptr<llvm::Module> curMod;
+
+        //lists the current implied loop has already made room in for all of its appends
+        std::set<llvm::Value*> presized;
+
+        //lists nothing but the current function can see (see ast::Lambda::generate). only
+        //these are grown in place, and they're freed when it returns
+        std::set<ast::DeclExpr*> ownedLists;
+        //whether n is, or is a temporary for, a variable in ownedLists
+        bool ownsList(ast::Node0* n);
+
+        //parameters of the current function, and the arguments they start out as
+        std::map<ast::DeclExpr*, llvm::Value*> params;
+
+        //the function for fn, which is generated later if it hasn't been already
+        llvm::Function* function(ast::Lambda* fn);
+
+        //put an alloca in the entry block, so it isn't repeated in loops
+        llvm::Value* entryAlloca(llvm::Type* t);
+        //put v in an alloca and return its address
+        llvm::Value* stackCopy(llvm::Value* v);
+
+        //these work on either kind of list. n is the node list came from
+        llvm::Value* listLength(llvm::Value* list);
+        llvm::Value* listData(ast::Node0* n, llvm::Value* list);
+
+        //list runtime, see runtime/list.h. lists are passed by address
+        void listReserve(llvm::Value* list, llvm::Value* len, llvm::Type* elem);
+        void listAppend(llvm::Value* list, llvm::Value* src, llvm::Value* n, llvm::Type* elem);
+        void listConcat(llvm::Value* out, llvm::Value* l, llvm::Value* r, llvm::Type* elem);
+        void listFree(llvm::Value* list);
+
+        //tensor runtime, see runtime/tensor.h. reduces tensors (by value) with op
+        llvm::Value* tensorReduce(const char* op, std::vector<llvm::Value*>& tensors,
+            unsigned rank, llvm::Type* elem);
+
+        //reduction runtime, see runtime/reduce.h. op is one of its kernels
+        llvm::Value* listReduce(const char* op, llvm::Value* data, llvm::Value* len,
+            llvm::Type* elem);
+
+        //thread pool, see runtime/pool.h. body is void(i8* ctx, i32 begin, i32 end)
+        void parallelFor(llvm::Function* body, llvm::Value* ctx, llvm::Value* n);
+
+    private:
+        std::unique_ptr<llvm::ExecutionEngine> engine; //owns curMod once jit() is called
+
+        std::map<ast::Lambda*, llvm::Function*> functions;
+        std::queue<ast::Lambda*> worklist; //of functions that are called but not generated
+
+        void genRunEntry(llvm::Function* entry);
+
+        //ret is void if it's null
+        llvm::Function* runtimeFunc(const char* name, unsigned numPtrs, unsigned numInts,
+            llvm::Type* ret = nullptr);
     };
 }
 
@@ -21,7 +21,7 @@ Parser::Parser(lex::Lexer *l)
     {
         tok::Token name;
         if (lexer->Expect(tok::identifier, name))
-            mod->name = Global().getIdent(name.value.ident_v);
+            mod->name = (std::string)Global().getIdent(name.value.ident_v);
         else
             err::ExpectedAfter(lexer, "identifier", "'module'");
 
@@ -31,9 +31,47 @@ void err::ExpectedAfter(lex::Lexer *l, const char *expected, const char *after)
 
 #endif
 
-void Error::init(Level lvl)
+namespace
 {
+    std::recursive_mutex outputMutex;
+
+    int printCaret(const tok::FullLocation& loc, int start)
+    {
+        int i;
+        for (i = start; i < loc.firstCol; ++i)
+            std::cerr.put(' ');
+        std::cerr.put('^');
+
+        return i + 1;
+    }
+
+    int printPostCaret(const tok::FullLocation& loc, int start)
+    {
+        int i;
+        for (i = start; i < loc.lastCol + 1; ++i)
+            std::cerr.put(' ');
+        std::cerr.put('^');
+
+        return i + 1;
+    }
+
+    int printUnderline(const tok::FullLocation& loc, int start)
+    {
+        int i;
+        for (i = start; i < loc.firstCol; ++i)
+            std::cerr.put(' ');
+        for (; i <= loc.lastCol; ++i)
+            std::cerr.put('~');
+
+        return i;
+    }
+}
+
+void Error::init(Level lvl, const tok::Location &l)
+{
+    lock = std::unique_lock<std::recursive_mutex>(outputMutex);
     posn = 0;
+    loc = Global().srcMgr.expand(l);
 
     std::cerr << loc << ": ";
 
@@ -62,10 +100,13 @@ Error::~Error()
 
 Error & Error::operator<< (const tok::Location &l)
 {
-    if (l.line != loc.line) //if its not on the same line, we need to print the new line
+    tok::FullLocation full = Global().srcMgr.expand(l);
+
+    //if its not on the same line, we need to print the new line
+    if (full.line != loc.line || full.fileName != loc.fileName)
         posn = 0;
 
-    loc = l;
+    loc = full;
 
     return *this;
 }
@@ -91,15 +132,15 @@ Error & Error::operator<< (Special toPrint)
     switch (toPrint)
     {
     case caret:
-        posn = loc.printCaret(posn);
+        posn = printCaret(loc, posn);
         break;
 
     case underline:
-        posn = loc.printUnderline(posn);
+        posn = printUnderline(loc, posn);
         break;
 
     case postcaret:
-        posn = loc.printPostCaret(posn);
+        posn = printPostCaret(loc, posn);
 
     default:
         break;
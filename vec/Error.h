@@ -3,8 +3,9 @@
 
 #include <iostream>
 #include <utility>
+#include <mutex>
 
-#include "Location.h"
+#include "SourceManager.h"
 
 namespace tok
 {
@@ -39,17 +40,20 @@ namespace err
     //to be thrown
     class FatalError {};
 
+    //one error is printed at a time. an Error holds on to the output until it dies, so ones
+    //from different threads don't get mixed up
     class Error
     {
+        std::unique_lock<std::recursive_mutex> lock;
         int posn;
-        tok::Location loc;
+        tok::FullLocation loc; //expanded right away, since we're going to print it
 
-        void init(Level lvl);
+        void init(Level lvl, const tok::Location &l);
 
     public:
-        Error(Level lvl, const tok::Location &loc) : loc(loc) {init(lvl);}
+        Error(Level lvl, const tok::Location &loc) {init(lvl, loc);}
 
-        Error(const tok::Location &loc) : loc(loc) {init(err::error);}
+        Error(const tok::Location &loc) {init(err::error, loc);}
 
         ~Error();
 
@@ -4,9 +4,9 @@
 #include "Value.h"
 #include "LLVM.h"
 #include "AstWalker.h"
+#include "Intrinsic.h"
 
 #include <cassert>
-#include <queue>
 
 using namespace ast;
 using namespace sa;
@@ -17,93 +17,186 @@ using namespace sa;
 //any constants are calcuated, and any constant, non-side-effecting
 //expressions are removed. Any remaining code marked "static" is executed
 
-//convenience for overload resolution
-typedef std::pair<typ::TypeCompareResult, DeclExpr*> ovr_result;
-struct pairComp
+OverloadCache sa::ovrCache;
+
+OverloadCache::OverloadCache()
+    : lookups(0), hits(0), candidates(0)
+{}
+
+size_t OverloadCache::KeyHash::operator()(const Key& k) const
 {
-    bool operator()(const ovr_result& lhs, const ovr_result& rhs) {return rhs.first < lhs.first;}
-};
-typedef std::priority_queue<ovr_result, std::vector<ovr_result>, pairComp> ovr_queue;
+    size_t h = std::hash<Ident>()(k.name);
+    h ^= std::hash<void*>()(k.sco) + 0x9e3779b9 + (h << 6) + (h >> 2);
+    h ^= k.argType.hash() + 0x9e3779b9 + (h << 6) + (h >> 2);
+    return h;
+}
 
-void OverloadCallExpr::resolveOverload(typ::Type argType, Exec* ex)
+OverloadCache::Result* OverloadCache::find(Ident name, NormalScope* sco, typ::Type argType)
 {
-    ovr_queue result;
+    ++lookups;
 
-    Ident name = fun->Name();
+    Key key = {name, sco, argType};
+    auto it = results.find(key);
+    //if something visible from sco changed since, it gets found again and replaced
+    if (it == results.end() || it->second.generation != sco->cacheGeneration())
+        return nullptr;
+
+    ++hits;
+    return &it->second;
+}
 
-    std::vector<DeclExpr*> functions = fun->sco->getVarDefs(name);
+OverloadCache::Result& OverloadCache::insert(Ident name, NormalScope* sco, typ::Type argType,
+                                             Result& res)
+{
+    Key key = {name, sco, argType};
+    Result& ret = results[key];
+    ret = move(res);
+    ret.generation = sco->cacheGeneration();
+    return ret;
+}
 
-    for (auto func : functions)
+void OverloadCache::printStats(std::ostream& os)
+{
+    os << "overload resolution: " << lookups << " lookups, " << hits << " cache hits";
+    if (lookups)
+        os << " (" << hits * 100 / lookups << "%)";
+    os << ", " << candidates << " candidates examined\n";
+}
+
+namespace
+{
+    //the type of func when it's called with argType. intrinsics like $ are declared over
+    //params, which are filled in from the arguments. the result isn't valid if they can't be
+    typ::FuncType calledType(DeclExpr* func, typ::Type argType)
     {
-        //ignore non-functions
-        if (!func->Type().getFunc().isValid())
-            continue;
-
-        result.push(
-            std::make_pair(
-                argType.compare(func->Type().getFunc().arg()),
-                func)
-            );
+        if (exact_cast<IntrinDeclExpr*>(func))
+            return typ::mgr.instantiate(func->Type(), argType).getFunc();
+        return func->Type().getFunc();
     }
 
-    //TODO: find a better way?
-    Node0* call = dynamic_cast<Node0*>(this);
+    //find the best matches for argType among the functions called name
+    OverloadCache::Result rankOverloads(Ident name, NormalScope* sco, typ::Type argType)
+    {
+        OverloadCache::Result res;
+        typ::TypeCompareResult bestScore = typ::TypeCompareResult::invalid;
+        bool anyFuncs = false;
+
+        for (auto func : sco->getVarDefs(name))
+        {
+            //ignore non-functions
+            if (!func->Type().getFunc().isValid())
+                continue;
+
+            anyFuncs = true;
+            ++ovrCache.candidates;
+
+            typ::FuncType called = calledType(func, argType);
+            if (!called.isValid())
+                continue;
+
+            typ::TypeCompareResult score = argType.compare(called.arg());
+            if (!score.isValid())
+                continue;
+
+            if (score < bestScore)
+            {
+                bestScore = score;
+                res.best.clear();
+            }
+            if (score == bestScore)
+                res.best.push_back(func);
+        }
+
+        //TODO: now try template functions. only intrinsics have params so far
+        if (!anyFuncs)
+            res.outcome = OverloadCache::Undefined;
+        else if (res.best.size() == 0)
+            res.outcome = OverloadCache::NoMatch;
+        else if (res.best.size() > 1)
+            res.outcome = OverloadCache::Ambiguous;
+        else
+            res.outcome = OverloadCache::Found;
+
+        return res;
+    }
 
-    //TODO: now try template functions
-    if (result.size() == 0)
+    OverloadCache::Result* lookupOverload(Ident name, NormalScope* sco, typ::Type argType)
     {
+        OverloadCache::Result* res = ovrCache.find(name, sco, argType);
+        if (!res)
+        {
+            OverloadCache::Result ranked = rankOverloads(name, sco, argType);
+            res = &ovrCache.insert(name, sco, argType, ranked);
+        }
+        return res;
+    }
+}
+
+void OverloadCallExpr::resolveOverload(typ::Type argType, Exec* ex)
+{
+    Ident name = fun->Name();
+    OverloadCache::Result* res = lookupOverload(name, fun->sco, argType);
+
+    Node0* call = this;
+
+    switch (res->outcome)
+    {
+    case OverloadCache::Undefined:
         err::Error(call->loc) << "function '" << name << "' is not defined in this scope"
             << err::underline << call->loc << err::caret;
         call->Annotate(typ::error);
         return;
-    }
-
-    ovr_result firstChoice = result.top();
 
-    if (!firstChoice.first.isValid())
-    {
+    case OverloadCache::NoMatch:
         err::Error(call->loc) << "no accessible instance of overloaded function '" << name
             << "' matches arguments of type " << argType << err::underline << call->loc << err::caret;
         call->Annotate(typ::error);
-    }
-    else if (result.size() > 1 && (result.pop(), firstChoice.first == result.top().first))
-    {
-        err::Error ambigErr(call->loc);
-        ambigErr << "overloaded call to '" << name << "' is ambiguous" << err::underline
-            << call->loc << err::caret << firstChoice.second->loc << err::note << "could be" << err::underline;
+        return;
 
-        while (result.size() && firstChoice.first == result.top().first)
+    case OverloadCache::Ambiguous:
         {
-            ambigErr << result.top().second->loc << err::note << "or" << err::underline;
-            result.pop();
+            err::Error ambigErr(call->loc);
+            ambigErr << "overloaded call to '" << name << "' is ambiguous" << err::underline
+                << call->loc << err::caret << res->best[0]->loc << err::note << "could be" << err::underline;
+
+            for (size_t i = 1; i < res->best.size(); ++i)
+                ambigErr << res->best[i]->loc << err::note << "or" << err::underline;
         }
-        ovrResult = firstChoice.second; //recover
-        call->Annotate(ovrResult->Type().getFunc().ret());
+        ovrResult = res->best[0]; //recover
+        call->Annotate(calledType(ovrResult, argType).ret());
+        //the call is bound to it now, so it has to be processed like a found one
+        if (ex && !exact_cast<IntrinDeclExpr*>(ovrResult))
+            ex->require(ovrResult);
+        return;
+
+    case OverloadCache::Found:
+        break;
     }
-    else //success
-    {
-        ovrResult = firstChoice.second;
-        call->Annotate(ovrResult->Type().getFunc().ret());
 
-        //if its an intrinsic, switch it to a special node
-        if (IntrinDeclExpr* intrin = exact_cast<IntrinDeclExpr*>(ovrResult))
-        {
-            Node0* parent = call->parent;
+    //success
+    ovrResult = res->best[0];
+    call->Annotate(calledType(ovrResult, argType).ret());
 
-            auto iCall = MkNPtr(new IntrinCallExpr(
-                detachSelfAs<OverloadCallExpr>(), intrin->intrin_id));
+    //if its an intrinsic, switch it to a special node
+    if (IntrinDeclExpr* intrin = exact_cast<IntrinDeclExpr*>(ovrResult))
+    {
+        Node0* parent = call->parent;
 
-            if (ex)
-                iCall->preExec(*ex);
+        //this may be an a[b] or a{b}, which detachSelfAs wouldn't take
+        auto iCall = MkNPtr(new IntrinCallExpr(
+            MkNPtr(static_cast<OverloadCallExpr*>(detachSelf().release())), intrin->intrin_id));
 
-            parent->replaceDetachedChild(move(iCall));
+        if (ex)
+            iCall->preExec(*ex);
 
-            //because *this is invalid, we don't want to accidentally do anything after here
-            return;
-        }
+        parent->replaceDetachedChild(move(iCall));
 
-        //TODO: process the function
+        //because *this is invalid, we don't want to accidentally do anything after here
+        return;
     }
+
+    if (ex)
+        ex->require(ovrResult);
 }
 
 void AssignExpr::preExec(Exec& ex)
@@ -311,11 +404,13 @@ void ArithCast::preExec(Exec&)
 
 void ListifyExpr::preExec(Exec& ex)
 {
+    for (auto& c : Children())
+        c->preExec(ex);
+
     typ::Type conts_t = getChild(0)->Type();
     Annotate(typ::mgr.makeList(conts_t, Children().size()));
     for (auto& c : Children())
     {
-        c->preExec(ex);
         if (conts_t.compare(c->Type()) == typ::TypeCompareResult::invalid)
             err::Error(getChild(0)->loc) << "list contents must be all the same type, " << conts_t
                 << " != " << c->Type() << err::underline << c->loc << err::underline;
@@ -333,6 +428,100 @@ void TuplifyExpr::preExec(Exec& ex)
     Annotate(typ::mgr.makeTuple(builder));
 }
 
+void IterExpr::preExec(Exec& ex)
+{
+    getChildA()->preExec(ex);
+
+    typ::ListType list = getChildA()->Type().getList();
+    typ::TensorType tensor = getChildA()->Type().getTensor();
+    if (list.isValid())
+        Annotate(list.conts());
+    else if (tensor.isValid())
+        Annotate(tensor.conts());
+    else
+    {
+        err::Error(getChildA()->loc) << "cannot iterate over type "
+            << getChildA()->Type() << ", it is not a list or tensor" << err::underline;
+        Annotate(typ::error);
+    }
+}
+
+void AggExpr::preExec(Exec& ex)
+{
+    getChildA()->preExec(ex);
+    typ::Type elem = getChildA()->Type();
+
+    if (targets.empty())
+    {
+        err::Error(loc) << "nothing to aggregate over, expected a ` expression" << err::underline;
+        Annotate(typ::error);
+        return;
+    }
+
+    for (auto t : targets)
+        if (!t->getChildA()->Type().getList().isValid())
+        {
+            err::Error(t->loc) << "only lists can be aggregated, use sum, min, or max for tensors"
+                << err::underline;
+            Annotate(typ::error);
+            return;
+        }
+
+    //elements are combined with the built in op for their type
+    typ::TupleBuilder args;
+    args.push_back(elem, Global().reserved.null);
+    args.push_back(elem, Global().reserved.null);
+    OverloadCache::Result* res = lookupOverload(
+        Global().findIdent(op), sco, typ::mgr.makeTuple(args));
+
+    IntrinDeclExpr* intrin = res->outcome == OverloadCache::Found
+        ? exact_cast<IntrinDeclExpr*>(res->best[0]) : nullptr;
+    //only arithmetic, codegen turns these into single instructions
+    bool arith = intrin && (intrin->intrin_id < intr::OPS::LESS
+        || (intrin->intrin_id >= intr::OPS::BITAND && intrin->intrin_id < intr::OPS::MOD));
+    if (!arith || intrin->Type().getFunc().ret() != elem)
+    {
+        err::Error(loc) << "'" << tok::Name(op) << "=' is not a built in operation on "
+            << elem << err::underline;
+        Annotate(typ::error);
+        return;
+    }
+
+    combineOp = intrin->intrin_id;
+    Annotate(elem);
+}
+
+void ImpliedLoopStmt::preExec(Exec& ex)
+{
+    getChildA()->preExec(ex);
+
+    //codegen emits the body once per element, so it has to be straight line code
+    for (auto n : Subtree<>(getChildA()))
+    {
+        if (n->Kind() == NodeKind::BranchStmt || n->Kind() == NodeKind::RhoStmt
+            || n->Kind() == NodeKind::PhiExpr)
+        {
+            err::Error(n->loc) << "control flow inside of ` expressions is not supported yet"
+                << err::underline;
+            break;
+        }
+    }
+
+    //lists get one loop and tensors get a loop nest, so they can't be mixed
+    typ::TensorType first = targets.front()->getChildA()->Type().getTensor();
+    for (auto t : targets)
+    {
+        typ::TensorType tensor = t->getChildA()->Type().getTensor();
+        if (tensor.isValid() != first.isValid()
+            || (tensor.isValid() && tensor.rank() != first.rank()))
+        {
+            err::Error(t->loc) << "cannot iterate over " << t->getChildA()->Type()
+                << " together with " << targets.front()->getChildA()->Type() << err::underline;
+            break;
+        }
+    }
+}
+
 void StmtPair::preExec(Exec& ex)
 {
     getChildA()->preExec(ex);
@@ -369,6 +558,7 @@ void BranchStmt::preExec(Exec& ex)
     getChildA()->preExec(ex);
 
     if (ifTrue != ifFalse //conditional, so child is condition
+        && getChildA()->Type() != typ::error //already reported
         && getChildA()->Type().compare(typ::boolean) == typ::TypeCompareResult::invalid)
         err::Error(getChildA()->loc) << "expected boolean type, got " << getChildA()->Type()
             << err::underline;
@@ -387,6 +577,12 @@ void PhiExpr::preExec(Exec&)
                 << err::underline;
 }
 
+void Exec::require(ast::DeclExpr* n)
+{
+    if (reached.insert(n).second)
+        worklist.push(n);
+}
+
 //TOOD: return type and value/call?
 void Exec::processFunc (ast::DeclExpr* n)
 {
@@ -399,6 +595,7 @@ void Exec::processFunc (ast::DeclExpr* n)
     else
     {
         Lambda* def = n->Value().getFunc().get();
+        utl::ArenaGuard ag(def->getArena()); //it may not be in the module we're processing
 
         typ::Type arg = ft.arg();
         typ::TupleType args = arg.getTuple();
@@ -420,6 +617,9 @@ void Exec::processFunc (ast::DeclExpr* n)
         else
             def->sco->getVarDef(def->params[0])->Annotate(arg);
 
+        //params may be functions, so overloads cached inside the function could be stale now
+        def->sco->invalidate();
+
         def->getChildA()->preExec(*this);
 
         for (auto ret : Subtree<ReturnStmt>(def))
@@ -427,6 +627,9 @@ void Exec::processFunc (ast::DeclExpr* n)
                 err::Error(ret->loc) << "cannot convert from "
                     << ret->getChildA()->Type() << " to " << ft.ret()
                     << " in function return" << err::underline;
+
+        fuseImpliedLoops(def);
+        markParallelLoops(def);
     }
 }
 
@@ -438,6 +641,8 @@ void Exec::processMod(ast::Module* mod)
         if (!import->execStarted)
             processMod(import);
 
+    utl::ArenaGuard ag(mod->nodeArena);
+
     //change functions into values so we don't enter them early
     for (auto func : Subtree<Lambda>(mod).cached())
     {
@@ -450,6 +655,8 @@ void Exec::processMod(ast::Module* mod)
     }
 
     mod->getChildA()->preExec(*this);
+    fuseImpliedLoops(mod);
+    markParallelLoops(mod);
 }
 
 Exec::Exec(ast::Module* mainMod)
@@ -458,6 +665,8 @@ Exec::Exec(ast::Module* mainMod)
 
     processMod(mainMod);
 
+    utl::ArenaGuard ag(mainMod->nodeArena);
+
     //now find the entry point and go!!
 
     DeclExpr* mainVar = mainMod->priv.getVarDef(Global().reserved.main);
@@ -474,7 +683,6 @@ Exec::Exec(ast::Module* mainMod)
         MkNPtr(new VarExpr(mainVar->Name(), mainVar->sco, mainVar->loc)),
         move(args), mainVar->loc);
 
-    //resolveOverload may be modified at some point to call processFunc
     entryPt.resolveOverload(typ::mgr.makeList(Global().reserved.string_t), this);
 
     if (!entryPt.ovrResult)
@@ -484,5 +692,13 @@ Exec::Exec(ast::Module* mainMod)
     }
 
     Global().entryPt = entryPt.ovrResult;
-    processFunc(entryPt.ovrResult);
+
+    //main, even if it was ambiguous, and everything it calls, and everything they call...
+    require(entryPt.ovrResult);
+    while (!worklist.empty())
+    {
+        DeclExpr* func = worklist.front();
+        worklist.pop();
+        processFunc(func);
+    }
 }
@@ -4,18 +4,91 @@
 #include "SemaNodes.h"
 #include <vector>
 #include <stack>
+#include <unordered_map>
+#include <unordered_set>
+#include <queue>
+#include <ostream>
 
 namespace sa
 {
-    //compile-time execution engine
+    //memoizes overload resolution. the result of resolving a name only depends on
+    //the scope it's looked up in and the argument type, as long as nothing visible from
+    //that scope changes
+    class OverloadCache
+    {
+    public:
+        enum Outcome
+        {
+            Found,
+            Undefined, //no function by that name
+            NoMatch, //no function accepts these arguments
+            Ambiguous
+        };
+
+        struct Result
+        {
+            Outcome outcome;
+            //the best match first. if ambiguous, all of the equally good matches
+            std::vector<ast::DeclExpr*> best;
+            unsigned int generation; //of the lookup scope, when this was found
+        };
+
+        OverloadCache();
+
+        //returns null if it's not cached
+        Result* find(Ident name, ast::NormalScope* sco, typ::Type argType);
+        Result& insert(Ident name, ast::NormalScope* sco, typ::Type argType, Result& res);
+
+        void printStats(std::ostream& os);
+
+        //statistics
+        unsigned long lookups;
+        unsigned long hits;
+        unsigned long candidates; //number of functions compared on misses
+
+    private:
+        struct Key
+        {
+            Ident name;
+            ast::NormalScope* sco;
+            typ::Type argType;
+            bool operator==(const Key& other) const
+            {return name == other.name && sco == other.sco && argType == other.argType;}
+        };
+        struct KeyHash
+        {
+            size_t operator()(const Key& k) const;
+        };
+
+        std::unordered_map<Key, Result, KeyHash> results;
+    };
+
+    extern OverloadCache ovrCache;
+
+    //merge adjacent implied loops over the same lists into one loop, when it
+    //doesn't change what either one computes. root must already be preExec'd
+    void fuseImpliedLoops(ast::Node0* root);
+
+    //with --parallel, mark the implied loops whose iterations don't depend on each other
+    //so codegen runs them on the thread pool. root must already be fused
+    void markParallelLoops(ast::Node0* root);
+
+    //compile-time execution engine. function bodies are only processed once a call
+    //resolves to them, starting with main, so code main can't reach is never checked
     class Exec
     {
+        std::unordered_set<ast::DeclExpr*> reached; //functions that have been queued
+        std::queue<ast::DeclExpr*> worklist; //reached and not processed yet
+
         void processMod(ast::Module* mod);
+        void processFunc(ast::DeclExpr* n);
 
     public:
         Exec(ast::Module* mainMod);
 
-        void processFunc(ast::DeclExpr* n);
+        //process n after whatever is being processed now, unless it already has been.
+        //bodies aren't processed inside each other because they share scope state
+        void require(ast::DeclExpr* n);
     };
 }
 
@@ -13,6 +13,9 @@ namespace ast
     //leaf expression type
     struct NullExpr : public Node0
     {
+        static const NodeKind kind = NodeKind::NullExpr;
+        NodeKind myKind() {return kind;}
+
         //some explanation of what this is doing here
         const char * const detail;
 
@@ -35,6 +38,9 @@ namespace ast
 
     struct VarExpr : public Node0
     {
+        static const NodeKind kind = NodeKind::VarExpr;
+        NodeKind myKind() {return kind;}
+
         NormalScope* sco; //the scope we're in
         bool isOp; //is this an operator?
 
@@ -61,6 +67,9 @@ namespace ast
 
     struct DeclExpr : public VarExpr
     {
+        static const NodeKind kind = NodeKind::DeclExpr;
+        NodeKind myKind() {return kind;}
+
         DeclExpr(Ident n, NormalScope* s, typ::Type t, tok::Location const &l)
             : VarExpr(n, s, l)
         {
@@ -80,7 +89,7 @@ namespace ast
             Annotate(other.Type());
         }
 
-        std::string myLbl() {return Type().to_str() + " " + Global().getIdent(Name());}
+        std::string myLbl() {return Type().to_str() + " " + (std::string)Global().getIdent(Name());}
 
         //have to re-override it back to the original
         annot_t& Annot() {return Node0::Annot();}
@@ -90,7 +99,7 @@ namespace ast
     //put this here so it knows what a DeclExpr is
     std::string VarExpr::myLbl()
     {
-        return sco->getVarDef(name) != 0 ? Global().getIdent(name) : "undefined var";
+        return sco->getVarDef(name) != 0 ? (std::string)Global().getIdent(name) : "undefined var";
     }
 
     Node0::annot_t& VarExpr::Annot()
@@ -104,6 +113,9 @@ namespace ast
 
     struct Lambda : public Node1
     {
+        static const NodeKind kind = NodeKind::Lambda;
+        NodeKind myKind() {return kind;}
+
         Ident name;
         std::vector<Ident> params;
         NormalScope* sco;
@@ -117,6 +129,9 @@ namespace ast
 
     struct ConstExpr : public Node0
     {
+        static const NodeKind kind = NodeKind::ConstExpr;
+        NodeKind myKind() {return kind;}
+
         ConstExpr(tok::Location &l)
             : Node0(l)
         {}
@@ -132,6 +147,9 @@ namespace ast
 
     struct AssignExpr : public Node2
     {
+        static const NodeKind kind = NodeKind::AssignExpr;
+        NodeKind myKind() {return kind;}
+
         AssignExpr(Ptr lhs, Ptr rhs, tok::Location &opLoc)
             : Node2(move(lhs), move(rhs), tok::Location()), opLoc(opLoc)
         {
@@ -146,6 +164,9 @@ namespace ast
 
     struct OpAssignExpr : public AssignExpr
     {
+        static const NodeKind kind = NodeKind::OpAssignExpr;
+        NodeKind myKind() {return kind;}
+
         tok::TokenType assignOp;
         NormalScope* sco;
         OpAssignExpr(Ptr lhs, Ptr rhs, tok::Token &o, NormalScope* sco)
@@ -155,13 +176,17 @@ namespace ast
 
     struct OverloadCallExpr : public NodeN
     {
+        static const NodeKind kind = NodeKind::OverloadCallExpr;
+        NodeKind myKind() {return kind;}
+
         OverloadCallExpr(NPtr<VarExpr>::type lhs, Ptr rhs, const tok::Location & l)
-            : fun(move(lhs)), NodeN(move(rhs), l) {}
+            : fun(move(lhs)), NodeN(move(rhs), l), ovrResult(nullptr) {}
         OverloadCallExpr(tok::Token op, ast::NormalScope *sco, Ptr a, Ptr b)
-            : fun(new VarExpr(op, sco)), NodeN(move(a), move(b), op.loc) {}
+            : fun(new VarExpr(op, sco)), NodeN(move(a), move(b), op.loc), ovrResult(nullptr) {}
         std::string myLbl() {return utl::to_str(fun->Name()) + " ?:?";};
 
         void preExec(sa::Exec&);
+        llvm::Value* generate(cg::CodeGen& gen);
         NPtr<VarExpr>::type fun;
         DeclExpr* ovrResult;
 
@@ -171,6 +196,9 @@ namespace ast
 
     struct IterExpr : public Node1
     {
+        static const NodeKind kind = NodeKind::IterExpr;
+        NodeKind myKind() {return kind;}
+
         IterExpr(Ptr arg, tok::Token &o)
             : Node1(move(arg))
         {
@@ -178,22 +206,36 @@ namespace ast
         };
 
         std::string myLbl() {return "`";}
+        void preExec(sa::Exec&);
+        llvm::Value* generate(cg::CodeGen& gen);
     };
 
     struct AggExpr : public Node1
     {
+        static const NodeKind kind = NodeKind::AggExpr;
+        NodeKind myKind() {return kind;}
+
         tok::TokenType op;
-        AggExpr(Ptr arg, tok::Token &o)
-            : Node1(move(arg)), op(o.value.op)
+        NormalScope* sco; //where to look up op
+        std::vector<IterExpr*> targets; //the lists it's aggregated over
+        int combineOp; //intrinsic id of the op for the element type
+
+        AggExpr(Ptr arg, tok::Token &o, NormalScope* sco)
+            : Node1(move(arg)), op(o.value.op), sco(sco), combineOp(-1)
         {
             loc = o.loc + getChildA()->loc;
         };
         std::string myLbl() {return tok::Name(op) + std::string("=");}
+        void preExec(sa::Exec&);
+        llvm::Value* generate(cg::CodeGen& gen);
     };
 
     //TODO: more accurate location
     struct ListifyExpr : public NodeN
     {
+        static const NodeKind kind = NodeKind::ListifyExpr;
+        NodeKind myKind() {return kind;}
+
         ListifyExpr(Ptr arg)
             : NodeN(move(arg), tok::Location())
         {
@@ -205,6 +247,9 @@ namespace ast
 
     struct TuplifyExpr : public NodeN
     {
+        static const NodeKind kind = NodeKind::TuplifyExpr;
+        NodeKind myKind() {return kind;}
+
         TuplifyExpr(Ptr arg)
             : NodeN(move(arg), tok::Location())
         {
@@ -218,6 +263,9 @@ namespace ast
     //for ++ and --
     struct PostExpr : public Node1
     {
+        static const NodeKind kind = NodeKind::PostExpr;
+        NodeKind myKind() {return kind;}
+
         tok::TokenType op;
         PostExpr(Ptr arg, tok::Token &o)
             : Node1(move(arg)), op(o.type)
@@ -229,6 +277,9 @@ namespace ast
 
     struct TupAccExpr : public OverloadCallExpr
     {
+        static const NodeKind kind = NodeKind::TupAccExpr;
+        NodeKind myKind() {return kind;}
+
         TupAccExpr(Ptr lhs, Ptr rhs, tok::Token &o, ast::NormalScope *sco)
             : OverloadCallExpr(o, sco, move(lhs), move(rhs))
         {}
@@ -238,6 +289,9 @@ namespace ast
 
     struct ListAccExpr : public OverloadCallExpr
     {
+        static const NodeKind kind = NodeKind::ListAccExpr;
+        NodeKind myKind() {return kind;}
+
         ListAccExpr(Ptr lhs, Ptr rhs, tok::Token &o, ast::NormalScope *sco)
             : OverloadCallExpr(o, sco, move(lhs), move(rhs))
         {}
@@ -47,7 +47,7 @@ Node0* Parser::parseBinaryExprRHS(Node0* lhs, tok::prec::precidence minPrec)
 
         //reduce
 
-        VarExpr* func = dynamic_cast<VarExpr*>(lhs);
+        VarExpr* func = node_cast<VarExpr*>(lhs);
         if (op == tok::colon && func)
             lhs = new OverloadCallExpr(MkNPtr(func), Ptr(rhs), op.loc);
         else if (op == tok::equals)
@@ -94,7 +94,7 @@ Node0* Parser::parseUnaryExpr()
         return new IterExpr(Ptr(parsePostfixExpr()), op);
     case tok::opequals:
         lexer->Advance();
-        return new AggExpr(Ptr(parseBinaryExprInAgg()), op);
+        return new AggExpr(Ptr(parseBinaryExprInAgg()), op, curScope);
     default:
         return parsePostfixExpr();
     }
@@ -5,15 +5,27 @@
 #include "Sema.h"
 #include "Exec.h"
 #include "CodeGen.h"
+#include "Intrinsic.h"
+#include "Parallel.h"
 
 #include "LLVM.h"
 
 #include <memory>
 #include <fstream>
+#include <iostream>
+#include <chrono>
+#include <cstdlib>
+#include <set>
+#include <algorithm>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
 
 Ident::operator llvm::StringRef() const
 {
-    return llvm::StringRef(Global().getIdent(*this));
+    utl::weak_string str = Global().getIdent(*this);
+    return llvm::StringRef(str.begin(), str.length());
 }
 
 std::unique_ptr<GlobalData> singleton;
@@ -30,61 +42,118 @@ GlobalData& Global()
     return *singleton;
 }
 
-ast::Module* GlobalData::ParseFile(const char* path)
+void GlobalData::ParseModule(ast::Module* mod, const std::string& path)
 {
-    allModules.emplace_back(path);
-    ast::Module* mod = &allModules.back();
-
-    mod->name = path;
-    auto ext = mod->name.find_first_of(".vc");
-    if (ext != std::string::npos)
-        mod->name.resize(ext);
+    utl::ArenaGuard ag(mod->nodeArena);
+    if (!moduleCache.load(mod))
+    {
+        //errors from other threads count too, which only means we store less
+        int oldErrors = numErrors;
+        lex::Lexer l(mod);
+        par::Parser p(&l);
 
-    lex::Lexer l(mod);
-    par::Parser p(&l);
+        std::ofstream dot(path + std::string(".1.dot"));
+        dot << "digraph G {\n";
+        mod->emitDot(dot);
+        dot << '}';
+        dot.close();
 
-    std::ofstream dot(path + std::string(".1.dot"));
-    dot << "digraph G {\n";
-    mod->emitDot(dot);
-    dot << '}';
-    dot.close();
+        sa::Sema s(mod);
 
-    sa::Sema s(mod);
+        s.Phase1();
 
-    s.Phase1();
+        //a hit skips the diagnostics, so only clean modules go in
+        if (numErrors == oldErrors)
+            moduleCache.store(mod);
+    }
 
     std::ofstream dot2(path + std::string(".2.dot"));
     dot2 << "digraph G {\n";
     mod->emitDot(dot2);
     dot2 << '}';
     dot2.close();
+}
+
+namespace
+{
+    typedef std::chrono::high_resolution_clock Clock;
 
-    return mod;
+    double millis(Clock::duration d)
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(d).count() / 1000.;
+    }
 }
 
-//don't output diagnostics
-//may add code later to suppress warnings
-void GlobalData::ParseBuiltin(const char* path)
+std::vector<ast::Module*> GlobalData::ParseFiles(const std::vector<std::string>& paths)
 {
-    allModules.emplace_back(path);
-    ast::Module* mod = &allModules.back();
-    mod->name = path;
+    Clock::time_point start = Clock::now();
 
-    lex::Lexer l(mod);
-    par::Parser p(&l);
+    //opening the files and naming the modules is quick, and allModules isn't thread safe
+    std::vector<ast::Module*> mods;
+    for (auto& path : paths)
+    {
+        allModules.emplace_back(path);
+        ast::Module* mod = &allModules.back();
+
+        //the output files are named after this, so only the .vc on the end goes
+        mod->name = path;
+        auto ext = mod->name.rfind(".vc");
+        if (ext != std::string::npos && ext + 3 == mod->name.size())
+            mod->name.resize(ext);
+
+        mods.push_back(mod);
+    }
+
+    //modules can't see each other until they're imported, so they can be parsed and
+    //lowered in any order
+    parseThreads = std::min<unsigned>(utl::numThreads(options.jobs), unsigned(mods.size()));
+    utl::parallelFor(mods.size(), parseThreads, [&] (size_t i)
+    {
+        ParseModule(mods[i], paths[i]);
+    });
 
-    sa::Sema s(mod);
-    s.Phase1();
+    parseMillis = millis(Clock::now() - start);
+    return mods;
 }
 
-void GlobalData::ParseMainFile(const char* path)
+namespace
 {
-    ParseBuiltin("intrinsic");
-    ast::Module* mainMod = ParseFile(path);
+    //put mod after everything it imports. visits imports in allModules order so the order
+    //is the same every time
+    void importOrder(ast::Module* mod, std::set<ast::Module*>& seen,
+        std::vector<ast::Module*>& order)
+    {
+        if (!seen.insert(mod).second) //done already, or an import cycle
+            return;
+
+        for (auto& other : Global().allModules)
+            if (mod->imports.count(&other))
+                importOrder(&other, seen, order);
+
+        order.push_back(mod);
+    }
+}
+
+void GlobalData::ParseMainFile(const std::vector<std::string>& paths)
+{
+    Clock::time_point start = Clock::now();
+    std::vector<ast::Module*> mods = ParseFiles(paths);
+    ast::Module* mainMod = mods[0];
+
+    //there's no syntax for imports yet, so the main file imports everything else
+    for (size_t i = 1; i < mods.size(); ++i)
+        mainMod->PublicImport(mods[i]);
+
+    std::set<ast::Module*> seen;
+    std::vector<ast::Module*> order;
+    importOrder(mainMod, seen, order);
+    for (auto mod : order)
+    {
+        utl::ArenaGuard ag(mod->nodeArena);
+        sa::Sema s(mod);
+        s.Import();
+    }
 
-    sa::Sema s(mainMod);
-    s.Import();
-    
     sa::Exec ex(mainMod);
 
     std::ofstream dot(mainMod->fileName + std::string(".3.dot"));
@@ -93,18 +162,41 @@ void GlobalData::ParseMainFile(const char* path)
     dot << '}';
     dot.close();
 
-    std::string outfile = mainMod->name + ".ll";
+    static const char* const extensions[] = {".ll", ".bc", ".o",
+#ifdef _WIN32
+        ".exe"
+#else
+        ""
+#endif
+    };
+    std::string outfile = mainMod->name + extensions[options.emit];
 
+    Clock::time_point codegenStart = Clock::now();
     cg::CodeGen gen(outfile);
+    codegenMillis = millis(Clock::now() - codegenStart);
+    if (!options.run)
+        return;
+
+    //so it's clear when the jit pays for itself
+    Clock::time_point generated = Clock::now();
+    cg::CodeGen::RunEntry entry = gen.jit();
+    Clock::time_point compiled = Clock::now();
+    int ret = entry();
+    Clock::time_point ran = Clock::now();
+
+    std::cerr << "compile: " << millis(compiled - start) << " ms (front end and codegen "
+        << millis(generated - start) << " ms, jit " << millis(compiled - generated) << " ms)\n"
+        << "run: " << millis(ran - compiled) << " ms, main returned " << ret << '\n';
 }
 
 Ident GlobalData::addIdent(const std::string &str)
 {
-    TblType::iterator it = std::find(identTbl.begin(), identTbl.end(), str);
-    Ident ret = mkIdent(it - identTbl.begin());
-    if (it == identTbl.end())
-        identTbl.push_back(move(str));
-    return ret;
+    return addIdent(str.data(), str.data() + str.size());
+}
+
+Ident GlobalData::addIdent(const char* begin, const char* end)
+{
+    return mkIdent(identTbl.intern(begin, end));
 }
 
 std::ostream& operator<<(std::ostream& lhs, Ident& rhs)
@@ -120,6 +212,31 @@ ast::Module* GlobalData::findModule(const std::string& name)
     return nullptr;
 }
 
+void GlobalData::PrintStats(std::ostream& os)
+{
+    sa::Sema::printStats(os);
+    sa::ovrCache.printStats(os);
+    moduleCache.printStats(os);
+
+    os << "parsing: " << allModules.size() << " module" << (allModules.size() == 1 ? "" : "s")
+        << " on " << parseThreads << " thread" << (parseThreads == 1 ? "" : "s") << " in "
+        << parseMillis << " ms\n";
+    os << "codegen: " << codegenPieces << " piece" << (codegenPieces == 1 ? "" : "s") << " in "
+        << codegenMillis << " ms\n";
+
+    os << "ast arenas:\n";
+    for (auto& mod : allModules)
+        os << "  " << mod.name << ": " << mod.nodeArena.numAllocations() << " allocations, "
+            << mod.nodeArena.bytesUsed() << " bytes used, "
+            << mod.nodeArena.bytesReserved() << " bytes reserved\n";
+
+#ifndef _WIN32
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+        os << "peak rss: " << usage.ru_maxrss << " KB\n"; //bytes on OS X, but close enough
+#endif
+}
+
 //don't put this in the constructor so stuff we call can access Global (ie the singleton
 //is set already)
 void GlobalData::Initialize()
@@ -132,7 +249,6 @@ void GlobalData::Initialize()
     reserved.init = addIdent("__init");
     reserved.string = addIdent("String");
     reserved.undeclared = addIdent("__undeclared");
-    reserved.intrin = addIdent("__intrin");
 
     //add pre defined stuff
     ast::TypeDef td;
@@ -141,6 +257,21 @@ void GlobalData::Initialize()
     reserved.string_t = typ::mgr.makeNamed(td.mapped, reserved.string);
 
     numErrors = 0;
+    options.stats = false;
+    options.dumpFusion = false;
+    options.strictFP = false;
+    options.parallel = false;
+    options.optLevel = 2;
+    options.emit = EMIT_LL;
+    options.run = false;
+    options.jobs = 0;
+    parseThreads = 0;
+    parseMillis = 0;
+    codegenPieces = 0;
+    codegenMillis = 0;
+
+    if (const char* dir = getenv("VEC_CACHE"))
+        moduleCache.setDir(dir);
 
     //HACK HACK
     for (tok::TokenType tt = tok::tilde; tt < tok::integer; tt = tok::TokenType(tt + 1))
@@ -153,13 +284,23 @@ void GlobalData::Initialize()
                 reserved.opIdents[tt] = addIdent(tok::Name(tt));
         }
     }
+
+    //needs the operator names
+    utl::ArenaGuard ag(universalArena);
+    intr::declare(universal);
 }
 
 GlobalData::~GlobalData()
 {
     //TODO: allow things to register code to be called at exit?
-    //universal declarations are not part of anyone's AST
-    //TODO: currently there are none. Do we need universal?
-    for (auto decl : universal.varDefs)
+    //Exec makes nodes for a module's functions in the main module's arena, so take down
+    //every tree before any of the arenas go
+    for (auto& mod : allModules)
+        mod.detachChildA();
+
+    //universal declarations are not part of anyone's AST. deleting one takes it out of
+    //varDefs, so go through a copy
+    std::vector<ast::DeclExpr*> decls = universal.varDefs;
+    for (auto decl : decls)
         delete decl;
 }
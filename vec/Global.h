@@ -2,8 +2,12 @@
 #define GLOBAL_H
 
 #include <vector>
+#include <atomic>
 #include "Type.h"
 #include "Module.h"
+#include "IdentTable.h"
+#include "ModuleCache.h"
+#include "SourceManager.h"
 
 typedef std::vector<std::string> TblType;
 
@@ -12,35 +16,47 @@ namespace ast
     struct DeclExpr;
 }
 
-//TODO: make members private and use synchronization to better support threads
-//it should be divided between members that are read-only, read-write, and
-//ones that are only used in single threaded code
+//TODO: make members private
+//modules are parsed on several threads at once, so anything ParseModule reaches has to be
+//read-only by then (universal, reserved, options) or synchronized (identTbl, srcMgr,
+//moduleCache, numErrors, typ::mgr). the rest is only used by one thread
 class GlobalData
 {
     void Initialize();
 
+    //lex, parse and lower mod, or load it from the cache. safe to call on different
+    //modules at the same time
+    void ParseModule(ast::Module* mod, const std::string& path);
+
 public:
     ~GlobalData();
 
     //deterministically create singleton to avoid stupid circular dependencies with TypeManager
     static void create();
     
-    void ParseMainFile(const char* path);
-
+    //the first file is the main one, it imports the rest
+    void ParseMainFile(const std::vector<std::string>& paths);
 
-    ast::Module* ParseFile(const char* path);
-    void ParseBuiltin(const char* path);
+    //make a module for each file and get them through Phase1, in parallel
+    std::vector<ast::Module*> ParseFiles(const std::vector<std::string>& paths);
 
     TblType stringTbl;
-    TblType identTbl;
+    utl::IdentTable identTbl;
+
+    //source file contents. must outlive allModules
+    tok::SourceManager srcMgr;
 
     Ident addIdent(const std::string &str);
+    Ident addIdent(const char* begin, const char* end);
 
     Ident findIdent(tok::TokenType to) {return reserved.opIdents[to];}
 
-    std::string & getIdent(Ident idx) {return identTbl[idx];}
+    //points into identTbl's arena, so it's nul terminated and never invalidated
+    utl::weak_string getIdent(Ident idx) {return identTbl.get(idx);}
 
     ast::NormalScope universal;
+    //for the nodes declared in universal, which aren't part of any module
+    utl::Arena universalArena;
 
     //reserved identifiers. like keywords, but handled as identifiers
     //for ease of parsing. the struct is syntactic sugar
@@ -54,22 +70,53 @@ public:
         Ident init; //really __init but __names are reserved
         Ident string;
         Ident undeclared;
-        Ident intrin; //__intrin
         ast::DeclExpr* undeclared_v;
-        ast::DeclExpr* intrin_v;
         typ::Type string_t;
 
         std::map<tok::TokenType, Ident> opIdents; //for operator+ etc
         //use some sort of hungarian notation here for clarity
     } reserved;
 
+    //what CodeGen writes
+    enum Emit
+    {
+        EMIT_LL, //<name>.ll, llvm assembly
+        EMIT_BC, //<name>.bc, llvm bitcode
+        EMIT_OBJ, //<name>.o, for the host
+        EMIT_EXE //<name>, the object linked with the runtime
+    };
+
+    //command line options
+    struct options
+    {
+        bool stats; //--stats. print compiler statistics when done
+        bool dumpFusion; //--dump-fusion. report which implied loops were fused or parallelized
+        bool strictFP; //--strict-fp. aggregate floats in order, so results are reproducible
+        bool parallel; //--parallel. run independent implied loops on the thread pool
+        int optLevel; //-O0 through -O3, -O2 by default. see CodeGen
+        Emit emit; //-emit=ll|bc|obj|exe, ll by default
+        bool run; //--run. compile main in memory and run it instead of writing anything
+        unsigned jobs; //-j<n>. threads to parse and optimize on. 0 (the default) parses on one per processor and optimizes the module whole
+    } options;
+
     std::list<ast::Module> allModules;
 
+    //modules as they are after Phase1, from earlier runs. off unless --cache=<dir> or
+    //$VEC_CACHE says where to keep them
+    ast::ModuleCache moduleCache;
+
     ast::Module* findModule(const std::string& name);
 
+    //for --stats
+    void PrintStats(std::ostream& os);
+    unsigned parseThreads; //that ParseFiles used
+    double parseMillis;
+    size_t codegenPieces; //that CodeGen split the functions into
+    double codegenMillis; //to generate, optimize and write out code
+
     ast::DeclExpr* entryPt;
 
-    int numErrors;
+    std::atomic<int> numErrors;
 
     friend GlobalData& Global();
 };
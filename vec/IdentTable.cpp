@@ -0,0 +1,112 @@
+#include "IdentTable.h"
+#include "Error.h"
+
+#include <cstring>
+
+using namespace utl;
+
+#define INITIAL_SLOTS 1024
+#define CHUNK_SIZE (64 * 1024)
+
+IdentTable::IdentTable()
+    : numStrs(0), chunkCur(nullptr), chunkEnd(nullptr)
+{
+    Slot empty = {0, -1};
+    slots.assign(INITIAL_SLOTS, empty);
+}
+
+//FNV-1a. identifiers are short, so anything fancier doesn't pay for itself
+size_t IdentTable::hash(const char* b, size_t len)
+{
+    size_t h = 2166136261u;
+    for (size_t i = 0; i < len; ++i)
+    {
+        h ^= (unsigned char)b[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+const char* IdentTable::store(const char* b, size_t len)
+{
+    if (size_t(chunkEnd - chunkCur) < len + 1)
+    {
+        //giant identifiers get a chunk of their own
+        size_t size = len + 1 > CHUNK_SIZE ? len + 1 : CHUNK_SIZE;
+        chunks.emplace_back(new char[size]);
+        chunkCur = chunks.back().get();
+        chunkEnd = chunkCur + size;
+    }
+
+    char* ret = chunkCur;
+    memcpy(ret, b, len);
+    ret[len] = '\0';
+    chunkCur += len + 1;
+    return ret;
+}
+
+void IdentTable::grow()
+{
+    Slot empty = {0, -1};
+    std::vector<Slot> old(slots.size() * 2, empty);
+    std::swap(old, slots);
+
+    size_t mask = slots.size() - 1;
+    for (auto& s : old)
+    {
+        if (s.idx < 0)
+            continue;
+        size_t pos = s.hash & mask;
+        while (slots[pos].idx >= 0)
+            pos = (pos + 1) & mask;
+        slots[pos] = s;
+    }
+}
+
+int IdentTable::intern(const char* b, const char* e)
+{
+    size_t len = e - b;
+    size_t h = hash(b, len);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t mask = slots.size() - 1;
+
+    size_t pos = h & mask;
+    for (; slots[pos].idx >= 0; pos = (pos + 1) & mask)
+    {
+        if (slots[pos].hash != h)
+            continue;
+        weak_string cand = get(slots[pos].idx);
+        if (cand.length() == len && memcmp(cand.begin(), b, len) == 0)
+            return slots[pos].idx;
+    }
+
+    //not found, add it
+    int idx = int(numStrs);
+    if ((idx >> STR_CHUNK_BITS) >= MAX_STR_CHUNKS)
+    {
+        err::Error(err::fatal, tok::Location()) << "too many identifiers";
+        throw err::FatalError();
+    }
+    std::unique_ptr<weak_string[]>& chunk = strChunks[idx >> STR_CHUNK_BITS];
+    if (!chunk)
+        chunk.reset(new weak_string[1 << STR_CHUNK_BITS]);
+
+    const char* stored = store(b, len);
+    chunk[idx & ((1 << STR_CHUNK_BITS) - 1)] = weak_string(stored, stored + len);
+    ++numStrs;
+    slots[pos].hash = h;
+    slots[pos].idx = idx;
+
+    //keep the load factor under 1/2 so probe sequences stay short
+    if (numStrs * 2 > slots.size())
+        grow();
+
+    return idx;
+}
+
+size_t IdentTable::size()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return numStrs;
+}
@@ -0,0 +1,65 @@
+#ifndef IDENTTABLE_H
+#define IDENTTABLE_H
+
+#include "Util.h"
+
+#include <vector>
+#include <memory>
+#include <mutex>
+
+namespace utl
+{
+    //interns identifier strings. each distinct string is stored once, in an arena that
+    //is only ever appended to, so the weak_strings handed out stay valid (and the indices
+    //stay stable) for the life of the table.
+    //lookup is an open addressing hash table with linear probing, so adding an identifier
+    //costs one hash and (usually) one string compare, no matter how many there are.
+    //intern can be called from any thread. get doesn't lock, which is fine because nothing
+    //it reads is ever moved, and an index can't be seen before intern has returned it
+    class IdentTable
+    {
+        struct Slot
+        {
+            size_t hash;
+            int idx; //-1 if empty
+        };
+
+        std::mutex mutex; //for everything but strChunks' contents once they're handed out
+
+        std::vector<Slot> slots; //size is always a power of two
+
+        //index -> string, in fixed size pieces so they never move
+        static const int STR_CHUNK_BITS = 12;
+        static const int MAX_STR_CHUNKS = 4096;
+        std::unique_ptr<weak_string[]> strChunks[MAX_STR_CHUNKS];
+        size_t numStrs;
+
+        //arena. chunks are never moved or freed until the table dies
+        std::vector<std::unique_ptr<char[]>> chunks;
+        char* chunkCur;
+        char* chunkEnd;
+
+        //copy [b, e) into the arena, nul terminated
+        const char* store(const char* b, size_t len);
+
+        //double the number of slots and rehash
+        void grow();
+
+        static size_t hash(const char* b, size_t len);
+
+    public:
+        IdentTable();
+
+        //return the index of [b, e), adding it if it's new
+        int intern(const char* b, const char* e);
+
+        weak_string get(int idx) const
+        {
+            return strChunks[idx >> STR_CHUNK_BITS][idx & ((1 << STR_CHUNK_BITS) - 1)];
+        }
+
+        size_t size();
+    };
+}
+
+#endif
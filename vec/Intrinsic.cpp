@@ -15,7 +15,9 @@ namespace ast {
 using namespace sa;
 using namespace intr;
 
-//This relies on the intrinsics being in the right order and all in one file
+//an intrinsic's id is its group's OPS value plus the offset of its type in the group, so
+//the cases below add the two. the groups are declared from the INTRINSICS table in
+//Intrinsic.h, and intr::declare asserts that the table's order agrees with OPS
 
 #define ARITH(op, type, opid, typid) \
     case (opid) + (typid): \
@@ -48,6 +50,15 @@ using namespace intr;
 
 void IntrinCallExpr::preExec(Exec&)
 {
+    //the runtime only has kernels for numbers
+    if (intrin_id >= OPS::SUM && intrin_id < OPS::END_REDUCE)
+    {
+        typ::Type elem = getChild(0)->Type().getTensor().conts();
+        if (!elem.getPrimitive().isArith())
+            err::Error(loc) << "cannot reduce a tensor of " << elem << err::underline;
+        return;
+    }
+
     //may need to change this if we do other things here
     for (auto& n : Children())
         if (!n->Value())
@@ -85,6 +96,137 @@ void IntrinCallExpr::preExec(Exec&)
 } //end using namespace
 
 
+//declarations
+
+namespace
+{
+    using namespace intr;
+
+    //the element type for each of TYPES
+    typ::Type numericType(int t)
+    {
+        static typ::Type* const types[NUM_NUMERIC_TYPES] =
+            {&typ::int8, &typ::int16, &typ::int32, &typ::int64,
+            &typ::float32, &typ::float64, &typ::float80};
+        return *types[t];
+    }
+
+    typ::Type args(typ::Type a, typ::Type b)
+    {
+        typ::TupleBuilder builder;
+        builder.push_back(a, Global().reserved.null);
+        builder.push_back(b, Global().reserved.null);
+        return typ::mgr.makeTuple(builder);
+    }
+
+    typ::Type binary(typ::Type ret, typ::Type arg)
+    {
+        return typ::mgr.makeFunc(ret, args(arg, arg));
+    }
+
+    class Declarer
+    {
+        ast::NormalScope& scope;
+        int id;
+
+        //the declarations come out numbered in the order they are made
+        void declare(Ident name, typ::Type t)
+        {
+            new ast::IntrinDeclExpr(name, &scope, t, id);
+            ++id;
+        }
+
+    public:
+        Declarer(ast::NormalScope& scope) : scope(scope), id(0) {}
+
+        void group(Ident name, int first, SHAPES shape)
+        {
+            assert(id == first && "intrinsic table is out of order with OPS");
+
+            typ::Type T = typ::mgr.makeParam(Global().addIdent("T"));
+            typ::Type listT = typ::mgr.makeList(T);
+
+            switch (shape)
+            {
+            case NUMERIC_BINARY:
+                for (int t = 0; t < NUM_NUMERIC_TYPES; ++t)
+                    declare(name, binary(numericType(t), numericType(t)));
+                break;
+
+            case NUMERIC_COMPARE:
+                for (int t = 0; t < NUM_NUMERIC_TYPES; ++t)
+                    declare(name, binary(typ::boolean, numericType(t)));
+                break;
+
+            case INT_BINARY:
+                for (int t = 0; t < NUM_INT_TYPES; ++t)
+                    declare(name, binary(numericType(t), numericType(t)));
+                break;
+
+            case INT_COMPARE:
+                for (int t = 0; t < NUM_INT_TYPES; ++t)
+                    declare(name, binary(typ::boolean, numericType(t)));
+                break;
+
+            case INT_UNARY:
+                for (int t = 0; t < NUM_INT_TYPES; ++t)
+                    declare(name, typ::mgr.makeFunc(numericType(t), numericType(t)));
+                break;
+
+            case BOOL_UNARY:
+                declare(name, typ::mgr.makeFunc(typ::boolean, typ::boolean));
+                break;
+
+            case CONCAT_LISTS:
+                declare(name, typ::mgr.makeFunc(listT, args(listT, listT)));
+                declare(name, typ::mgr.makeFunc(listT, args(T, listT)));
+                declare(name, typ::mgr.makeFunc(listT, args(listT, T)));
+                break;
+
+            case SUBSCRIPT_LIST:
+                declare(name, typ::mgr.makeFunc(T, args(listT, typ::int64)));
+                break;
+
+            case VIEW_LIST:
+                declare(name, typ::mgr.makeFunc(typ::mgr.makeTensor(T, 1), listT));
+                declare(name, typ::mgr.makeFunc(typ::mgr.makeTensor(T, 2), args(listT, typ::int64)));
+                break;
+
+            case REDUCE_TENSOR:
+                for (int r = 1; r <= MAX_REDUCE_RANK; ++r)
+                    declare(name, typ::mgr.makeFunc(T, typ::mgr.makeTensor(T, r)));
+                break;
+
+            case DOT_TENSORS:
+                for (int r = 1; r <= MAX_REDUCE_RANK; ++r)
+                    declare(name, typ::mgr.makeFunc(T,
+                        args(typ::mgr.makeTensor(T, r), typ::mgr.makeTensor(T, r))));
+                break;
+            }
+        }
+
+        int count() {return id;}
+    };
+}
+
+void intr::declare(ast::NormalScope& scope)
+{
+    Declarer d(scope);
+
+#define DECLARE_OP(id, token, shape) \
+    d.group(Global().findIdent(tok::token), OPS::id, shape);
+#define DECLARE_NAMED(id, name, shape) \
+    d.group(Global().addIdent(name), OPS::id, shape);
+
+    INTRINSICS(DECLARE_OP, DECLARE_NAMED)
+
+#undef DECLARE_OP
+#undef DECLARE_NAMED
+
+    assert(d.count() == OPS::END_REDUCE && "intrinsic table is out of order with OPS");
+}
+
+
 //code generation
 
 namespace ast {
@@ -114,32 +256,201 @@ using namespace llvm;
 #define SET_BIN_OP(types, op, llvmop)   SET_FOR(binOp, types, op, llvmop)
 #define SET_PRED(types, op, llvmop)     SET_FOR(pred,  types, op, llvmop)
 
+} //end namespace ast
+
+bool cg::arithOp(int intrin_id, llvm::Instruction::BinaryOps& binOp)
+{
+    switch (intrin_id)
+    {
+        SET_BIN_OP(INTS, intr::OPS::PLUS, llvm::Instruction::BinaryOps::Add);
+        SET_BIN_OP(FLOATS, intr::OPS::PLUS, llvm::Instruction::BinaryOps::FAdd);
+        SET_BIN_OP(INTS, intr::OPS::MINUS, llvm::Instruction::BinaryOps::Sub);
+        SET_BIN_OP(FLOATS, intr::OPS::MINUS, llvm::Instruction::BinaryOps::FSub);
+        SET_BIN_OP(INTS, intr::OPS::TIMES, llvm::Instruction::BinaryOps::Mul);
+        SET_BIN_OP(FLOATS, intr::OPS::TIMES, llvm::Instruction::BinaryOps::FMul);
+        SET_BIN_OP(INTS, intr::OPS::DIVIDE, llvm::Instruction::BinaryOps::SDiv);
+        SET_BIN_OP(FLOATS, intr::OPS::DIVIDE, llvm::Instruction::BinaryOps::FDiv);
+
+        SET_BIN_OP(INTS, intr::OPS::BITAND, llvm::Instruction::BinaryOps::And);
+        SET_BIN_OP(INTS, intr::OPS::BITOR, llvm::Instruction::BinaryOps::Or);
+        SET_BIN_OP(INTS, intr::OPS::BITXOR, llvm::Instruction::BinaryOps::Xor);
+
+    default:
+        return false;
+    }
+    return true;
+}
+
+namespace ast {
+
+VarExpr* ast::IntrinCallExpr::appendTarget()
+{
+    if (intrin_id != intr::OPS::CONCAT && intrin_id != intr::OPS::CONCAT + 2)
+        return nullptr;
+
+    AssignExpr* asgn = exact_cast<AssignExpr*>(parent);
+    if (!asgn || asgn->getChildB() != this)
+        return nullptr;
+
+    //x $= y assigns through temporaries
+    Node0* target = asgn->getChildA();
+    while (TmpExpr* tmp = exact_cast<TmpExpr*>(target))
+        target = tmp->setBy;
+
+    //variables share their declaration's annotation, so this means it's the same variable
+    VarExpr* var = node_cast<VarExpr*>(target);
+    return var && &var->Annot() == &getChild(0)->Annot() ? var : nullptr;
+}
+
+namespace
+{
+    bool isConcat(ast::Node0* n)
+    {
+        ast::IntrinCallExpr* call = exact_cast<ast::IntrinCallExpr*>(n);
+        return call && call->intrin_id >= intr::OPS::CONCAT && call->intrin_id < intr::OPS::SUBSCRIPT;
+    }
+
+    //a list of one element, on the stack
+    llvm::Value* singleton(llvm::Value* elem, llvm::Type* list_t, CodeGen& cgen)
+    {
+        llvm::Type* len_t = llvm::Type::getInt32Ty(getGlobalContext());
+        llvm::Value* list = UndefValue::get(list_t);
+        list = InsertValueInst::Create(list, cgen.stackCopy(elem), LIST_DATA, "", cgen.curBB);
+        list = InsertValueInst::Create(list, ConstantInt::get(len_t, 1), LIST_LEN, "", cgen.curBB);
+        //borrowed, so it's never freed
+        return InsertValueInst::Create(list, ConstantInt::get(len_t, 0), LIST_CAP, "", cgen.curBB);
+    }
+
+    //[T] $ [T], T $ [T], and [T] $ T
+    //if nothing else can see the left list (it's the result of another $, or the result
+    //is assigned right back to a list the function owns) the right side is appended to it
+    //in place. otherwise the result is a new list
+    llvm::Value* genConcat(ast::IntrinCallExpr* call, CodeGen& cgen)
+    {
+        bool elemLeft = call->intrin_id == intr::OPS::CONCAT + 1;
+        bool elemRight = call->intrin_id == intr::OPS::CONCAT + 2;
+
+        llvm::Value* lhs = call->getChild(0)->gen(cgen);
+        llvm::Value* rhs = call->getChild(1)->gen(cgen);
+        typ::Type list = call->getChild(elemLeft ? 1 : 0)->Type();
+        llvm::Type* list_t = list.toLLVM();
+        llvm::Type* elem_t = list.getList().conts().toLLVM();
+
+        //only a list nothing else can see can be grown in place
+        ast::VarExpr* target = call->appendTarget();
+        if (target && !cgen.ownsList(target))
+            target = nullptr;
+
+        //the implied loop already made room for this
+        if (elemRight && target && cgen.presized.count(target->Address()))
+        {
+            llvm::Value* len = ExtractValueInst::Create(lhs, LIST_LEN, "", cgen.curBB);
+            llvm::Value* data = ExtractValueInst::Create(lhs, LIST_DATA, "", cgen.curBB);
+            llvm::Value* addr = GetElementPtrInst::Create(data, len, "", cgen.curBB);
+            new StoreInst(rhs, addr, cgen.curBB);
+            len = BinaryOperator::Create(Instruction::BinaryOps::Add,
+                len, ConstantInt::get(len->getType(), 1), "", cgen.curBB);
+            return InsertValueInst::Create(lhs, len, LIST_LEN, "", cgen.curBB);
+        }
+
+        if (!elemLeft && (target || isConcat(call->getChild(0))))
+        {
+            llvm::Value* src, *n;
+            if (elemRight)
+            {
+                src = cgen.stackCopy(rhs);
+                n = ConstantInt::get(llvm::Type::getInt32Ty(getGlobalContext()), 1);
+            }
+            else
+            {
+                src = ExtractValueInst::Create(rhs, LIST_DATA, "", cgen.curBB);
+                n = ExtractValueInst::Create(rhs, LIST_LEN, "", cgen.curBB);
+            }
+
+            llvm::Value* addr = cgen.stackCopy(lhs);
+            cgen.listAppend(addr, src, n, elem_t);
+            return new LoadInst(addr, "", cgen.curBB);
+        }
+
+        if (elemLeft)
+            lhs = singleton(lhs, list_t, cgen);
+        if (elemRight)
+            rhs = singleton(rhs, list_t, cgen);
+
+        llvm::Value* out = cgen.entryAlloca(list_t);
+        cgen.listConcat(out, cgen.stackCopy(lhs), cgen.stackCopy(rhs), elem_t);
+        return new LoadInst(out, "", cgen.curBB);
+    }
+}
+
 Value* ast::IntrinCallExpr::generate(CodeGen& cgen)
 {
-    //first handle the easy cases
-    Instruction::BinaryOps otherOp = Instruction::BinaryOps(-1);
-    Instruction::BinaryOps binOp;
+    if (isConcat(this))
+        return genConcat(this, cgen);
 
-    switch (intrin_id)
+    if (intrin_id >= intr::OPS::SUM && intrin_id < intr::OPS::END_REDUCE)
     {
-        SET_BIN_OP(INTS, intr::OPS::PLUS, Instruction::BinaryOps::Add);
-        SET_BIN_OP(FLOATS, intr::OPS::PLUS, Instruction::BinaryOps::FAdd);
-        SET_BIN_OP(INTS, intr::OPS::MINUS, Instruction::BinaryOps::Sub);
-        SET_BIN_OP(FLOATS, intr::OPS::MINUS, Instruction::BinaryOps::FSub);
-        SET_BIN_OP(INTS, intr::OPS::TIMES, Instruction::BinaryOps::Mul);
-        SET_BIN_OP(FLOATS, intr::OPS::TIMES, Instruction::BinaryOps::FMul);
-        SET_BIN_OP(INTS, intr::OPS::DIVIDE, Instruction::BinaryOps::SDiv);
-        SET_BIN_OP(FLOATS, intr::OPS::DIVIDE, Instruction::BinaryOps::FDiv);
+        static const char* const names[] = {"sum", "min", "max", "dot"};
+        typ::TensorType tensor = getChild(0)->Type().getTensor();
+
+        std::vector<llvm::Value*> tensors;
+        for (auto& c : Children())
+            tensors.push_back(c->gen(cgen));
+        return cgen.tensorReduce(names[(intrin_id - intr::OPS::SUM) / intr::MAX_REDUCE_RANK],
+            tensors, tensor.rank(), tensor.conts().toLLVM());
+    }
 
-        SET_BIN_OP(INTS, intr::OPS::BITAND, Instruction::BinaryOps::And);
-        SET_BIN_OP(INTS, intr::OPS::BITOR, Instruction::BinaryOps::Or);
-        SET_BIN_OP(INTS, intr::OPS::BITXOR, Instruction::BinaryOps::Xor);
+    if (intrin_id == intr::OPS::SUBSCRIPT)
+    {
+        llvm::Value* list = getChild(0)->gen(cgen);
+        llvm::Value* idx = getChild(1)->gen(cgen);
+        llvm::Value* addr = GetElementPtrInst::Create(
+            cgen.listData(getChild(0), list), idx, "", cgen.curBB);
+        Annotate(addr); //so elements can be assigned to
+        return new LoadInst(addr, "", cgen.curBB);
+    }
 
-    default:
-        binOp = otherOp;
+    if (intrin_id == intr::OPS::TENSOR)
+    {
+        //a view of the list's data, so it's shared the same way subscripting is
+        llvm::Value* list = getChild(0)->gen(cgen);
+        llvm::Value* data = ExtractValueInst::Create(list, LIST_DATA, "", cgen.curBB);
+        llvm::Value* len = ExtractValueInst::Create(list, LIST_LEN, "", cgen.curBB);
+        llvm::Type* int32 = len->getType();
+        llvm::Value* zero = ConstantInt::get(int32, 0);
+        llvm::Value* one = ConstantInt::get(int32, 1);
+
+        int rank = Type().getTensor().rank();
+        llvm::Value* shape[2] = {len, 0};
+        llvm::Value* strides[2] = {one, 0};
+        if (rank == 2)
+        {
+            //rows of cols elements. leftover elements aren't part of the view, and there
+            //are no rows at all if cols isn't positive
+            llvm::Value* cols = new TruncInst(getChild(1)->gen(cgen), int32, "", cgen.curBB);
+            llvm::Value* positive = new ICmpInst(*cgen.curBB, CmpInst::ICMP_SGT, cols, zero);
+            llvm::Value* divisor = SelectInst::Create(positive, cols, one, "", cgen.curBB);
+            llvm::Value* rows = BinaryOperator::Create(Instruction::SDiv, len, divisor, "", cgen.curBB);
+            shape[0] = SelectInst::Create(positive, rows, zero, "", cgen.curBB);
+            shape[1] = cols;
+            strides[0] = cols;
+        }
+
+        llvm::Value* tensor = UndefValue::get(Type().toLLVM());
+        tensor = InsertValueInst::Create(tensor, data, TENSOR_DATA, "", cgen.curBB);
+        for (int d = 0; d < rank; ++d)
+        {
+            unsigned shapeIdx[] = {TENSOR_SHAPE, unsigned(d)};
+            unsigned strideIdx[] = {TENSOR_STRIDES, unsigned(d)};
+            tensor = InsertValueInst::Create(tensor, shape[d], shapeIdx, "", cgen.curBB);
+            tensor = InsertValueInst::Create(tensor, strides[d], strideIdx, "", cgen.curBB);
+        }
+        return tensor;
     }
 
-    if (binOp != otherOp)
+    //first handle the easy cases
+    Instruction::BinaryOps binOp;
+    if (arithOp(intrin_id, binOp))
     {
         llvm::Value* lhs = getChild(0)->gen(cgen);
         llvm::Value* rhs = getChild(1)->gen(cgen);
@@ -1,6 +1,11 @@
 #ifndef INTRINSIC_H
 #define INTRINSIC_H
 
+namespace ast
+{
+    class NormalScope;
+}
+
 namespace intr
 {
 
@@ -18,6 +23,12 @@ enum TYPES
     NUM_NUMERIC_TYPES
 };
 
+//reductions are declared once for each tensor rank up to this
+enum
+{
+    MAX_REDUCE_RANK = 4
+};
+
 enum OPS
 {
     PLUS,
@@ -38,8 +49,62 @@ enum OPS
     INCREMENT = DECREMENT + TYPES::NUM_INT_TYPES,
     NOT       = INCREMENT + TYPES::NUM_INT_TYPES,
     CONCAT,
-    SUBSCRIPT = CONCAT    + 3
+    SUBSCRIPT = CONCAT    + 3,
+    TENSOR,
+    SUM       = TENSOR    + 2,
+    MINIMUM   = SUM       + MAX_REDUCE_RANK,
+    MAXIMUM   = MINIMUM   + MAX_REDUCE_RANK,
+    DOT       = MAXIMUM   + MAX_REDUCE_RANK,
+    END_REDUCE = DOT      + MAX_REDUCE_RANK
 };
 
+//what a group of intrinsics is declared for. a group takes one id for each declaration,
+//in the order listed here
+enum SHAPES
+{
+    NUMERIC_BINARY, //t:{t, t} for each numeric t, in TYPES order
+    NUMERIC_COMPARE, //bool:{t, t} for each numeric t
+    INT_BINARY, //t:{t, t} for each integer t
+    INT_COMPARE, //bool:{t, t} for each integer t
+    INT_UNARY, //t:{t} for each integer t
+    BOOL_UNARY, //bool:bool
+    CONCAT_LISTS, //[?T]:{[?T], [?T]}, [?T]:{?T, [?T]}, [?T]:{[?T], ?T}
+    SUBSCRIPT_LIST, //?T:{[?T], int!64}
+    VIEW_LIST, //[?T, 1]:[?T], and [?T, 2]:{[?T], int!64} for rows of that many columns
+    REDUCE_TENSOR, //?T:{[?T, r]} for r from 1 to MAX_REDUCE_RANK
+    DOT_TENSORS //?T:{[?T, r], [?T, r]} for r from 1 to MAX_REDUCE_RANK
+};
+
+//every group of intrinsics, in OPS order. OP(id, token, shape) overloads the operator
+//token (a tok::TokenType); NAMED(id, name, shape) declares a function called name
+#define INTRINSICS(OP, NAMED) \
+    OP(PLUS,         plus,         NUMERIC_BINARY) \
+    OP(MINUS,        minus,        NUMERIC_BINARY) \
+    OP(TIMES,        star,         NUMERIC_BINARY) \
+    OP(DIVIDE,       slash,        NUMERIC_BINARY) \
+    OP(LESS,         less,         NUMERIC_COMPARE) \
+    OP(NOGREATER,    notgreater,   INT_COMPARE) \
+    OP(GREATER,      greater,      NUMERIC_COMPARE) \
+    OP(NOLESS,       notless,      INT_COMPARE) \
+    OP(EQUAL,        equalsequals, INT_COMPARE) \
+    OP(NOTEQUAL,     notequals,    INT_COMPARE) \
+    OP(BITAND,       amp,          INT_BINARY) \
+    OP(BITOR,        bar,          INT_BINARY) \
+    OP(BITXOR,       caret,        INT_BINARY) \
+    OP(MOD,          percent,      INT_BINARY) \
+    OP(DECREMENT,    minusminus,   INT_UNARY) \
+    OP(INCREMENT,    plusplus,     INT_UNARY) \
+    OP(NOT,          bang,         BOOL_UNARY) \
+    OP(CONCAT,       dollar,       CONCAT_LISTS) \
+    OP(SUBSCRIPT,    lsquare,      SUBSCRIPT_LIST) \
+    NAMED(TENSOR,    "tensor",     VIEW_LIST) \
+    NAMED(SUM,       "sum",        REDUCE_TENSOR) \
+    NAMED(MINIMUM,   "min",        REDUCE_TENSOR) \
+    NAMED(MAXIMUM,   "max",        REDUCE_TENSOR) \
+    NAMED(DOT,       "dot",        DOT_TENSORS)
+
+//declare all of the intrinsics in scope
+void declare(ast::NormalScope& scope);
+
 }
 #endif
\ No newline at end of file
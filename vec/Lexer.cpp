@@ -18,14 +18,9 @@ using namespace lex;
 
 
 Lexer::Lexer(ast::Module *mod)
-    : mod(mod)
+    : src(mod->source), mod(mod)
 {
-    curChr = mod->buffer - 1; //will be incremented
-    nextTok.loc.firstCol = nextTok.loc.lastCol = -1; //will be incremented
-    nextTok.loc.line = 1; //lines are 1 based
-
-    nextTok.loc.lineStr.assign(mod->buffer);
-    nextTok.loc.fileName = mod->fileName.c_str();
+    curChr = src->begin() - 1; //will be incremented
 
     Advance();
 }
@@ -156,9 +151,7 @@ inline void Lexer::lexIdent()
 {
     const char * end = getEndOfWord(curChr);
     nextTok.type = tok::identifier;
-    //TODO: construct string in place
-    std::string idname(curChr, end);
-    nextTok.value.ident_v = Global().addIdent(idname);
+    nextTok.value.ident_v = Global().addIdent(curChr, end);
     nextTok.loc.setLength(end - curChr);
     curChr = end - 1;
 }
@@ -313,22 +306,22 @@ inline char Lexer::consumeChar()
             ret = '\\';
             break;
         default:
-            tok::Location escLoc = nextTok.loc;
-            escLoc.firstCol = nextTok.loc.lastCol + 1;
+            tok::Location escLoc = src->locationOf(curChr);
+            escLoc.setLength(2);
             err::Error(err::error, escLoc) << "invalid escape sequence '\\"
                 << curChr[1] << '\'' << err::caret;
             ret = 0;
             break;
         }
         curChr += 2;
-        nextTok.loc.lastCol += 2;
+        nextTok.loc.end += 2;
         return ret;
     }
     else if (curChr[0] != '\0')
     {
         ret = curChr[0];
         curChr++;
-        nextTok.loc.lastCol++;
+        nextTok.loc.end++;
         return ret;
     }
 
@@ -340,7 +333,7 @@ inline void Lexer::lexChar()
     nextTok.type = tok::integer;
 
     curChr++; //skip over '
-    nextTok.loc.lastCol = nextTok.loc.firstCol + 1;
+    nextTok.loc.setLength(2); //the quote and the first char
     nextTok.value.int_v = consumeChar();
 
     if (*curChr == '\'') //otherwise, unterminated
@@ -368,7 +361,7 @@ inline void Lexer::lexString()
     nextTok.type = tok::stringlit;
 
     curChr++; //skip over "
-    nextTok.loc.lastCol = nextTok.loc.firstCol + 1;
+    nextTok.loc.setLength(2); //the quote and the first char
 
     curVal = val::Value::scalarSeq(sizeof(char));
     val::Value chr((char)0);
@@ -392,12 +385,10 @@ void Lexer::Advance()
 
     curTok = nextTok;
 
-    nextTok.loc.firstCol = nextTok.loc.lastCol;
-
 lexMore: //more elegant, in this case, than a while(true)
 
-    ++nextTok.loc.firstCol;
     ++curChr;
+    nextTok.loc = src->locationOf(curChr);
 
     switch (*curChr)
     {
@@ -410,11 +401,7 @@ lexMore: //more elegant, in this case, than a while(true)
         //eat whitespace
 
     case '\n':
-        ++nextTok.loc.line;
-        nextTok.loc.firstCol = -TAB_SIZE; //to compensate for tab
-        nextTok.loc.lineStr = utl::weak_string(curChr + 1);
     case '\t':
-        nextTok.loc.firstCol += TAB_SIZE - 1; //add 3 extra spaces for tab
     case '\r':
     case '\v':
     case ' ':
@@ -543,23 +530,9 @@ lexMore: //more elegant, in this case, than a while(true)
         if (curChr[1] == '*') //c style comment
         {
             while (*curChr != '\0' && (*curChr != '*' || curChr[1] != '/'))
-            {
-                ++nextTok.loc.firstCol;
-                if (*curChr == '\n')
-                {
-                    ++nextTok.loc.line;
-                    nextTok.loc.firstCol = 0;
-                    nextTok.loc.lineStr = utl::weak_string(curChr + 1);
-                }
-                else if (*curChr == '\t')
-                    nextTok.loc.firstCol += TAB_SIZE;
                 ++curChr;
-            }
             if (*curChr == '*')
-            {
-                ++nextTok.loc.firstCol;
                 ++curChr;
-            }
             else
                 --curChr; //don't run past \0
             goto lexMore;
@@ -4,6 +4,7 @@
 #include "Token.h"
 #include "Util.h"
 #include "Value.h"
+#include "SourceManager.h"
 
 #include <vector>
 
@@ -42,6 +43,7 @@ namespace lex
 
     private:
 
+        const tok::SourceBuffer* src;
         const char * curChr;
 
         tok::Token nextTok;
@@ -2,41 +2,29 @@
 #define LOCATION_H
 
 #include "Util.h"
-#include <ostream>
+
+#include <cstdint>
 
 #define TAB_SIZE 8
 
 namespace tok
 {
+    //a range of source text, as offsets into the space that SourceManager lays all of the
+    //files out in. this is small enough to copy around everywhere; use
+    //SourceManager::expand to get line / column info back when printing it
     struct Location
     {
-        int line;
-        int firstCol, lastCol;
-
-        Location();
-
-        const char * fileName; //char * instead of weak_string because we have nul terminator
-        
-        utl::weak_string lineStr;
+        uint32_t begin, end; //[begin, end). 0 means nowhere
 
-        int printCaret(int start = 0);
-        int printPostCaret(int start = 0);
-        int printUnderline(int start = 0);
+        Location() : begin(0), end(0) {}
+        Location(uint32_t begin, uint32_t end) : begin(begin), end(end) {}
 
-        void setLength(int nCols);
-        int getLength() {return lastCol - firstCol + 1;};
+        void setLength(int nChars) {end = begin + nChars;}
+        int getLength() {return end - begin;}
     };
 
     Location operator+ (Location & lhs, Location & rhs);
     Location& operator+= (Location & lhs, Location & rhs);
-
-    template <class CharT, class Traits>
-    inline std::basic_ostream<CharT, Traits>& 
-        operator<< (std::basic_ostream<CharT, Traits>& os, const Location& loc)
-    {
-        os << loc.fileName << ':' << loc.line << ':' << loc.firstCol;
-        return os;
-    }
 }
 
 #endif
@@ -0,0 +1,249 @@
+#include "Exec.h"
+#include "Global.h"
+#include "AstWalker.h"
+
+#include <unordered_set>
+#include <algorithm>
+#include <iostream>
+
+using namespace ast;
+using namespace sa;
+
+//Implied loop fusion:
+
+//`a = `b + 1; `c = `a * 2; runs as two loops. if they run the same number of times,
+//running both bodies in one loop is the same thing, as long as neither body cares about
+//anything but the current element of the lists the other one writes. each loop runs over
+//its shortest list, so we only know they run the same number of times if they iterate over
+//the same variables, or over fixed length lists with the same shortest length. so this
+//fuses when a, b, and c are [int]!4, but not when they're [int]
+
+//the same question decides whether a loop can be split up between threads: each
+//iteration may only look at its own element of the lists that get written
+
+namespace
+{
+    typedef std::unordered_set<DeclExpr*> DeclSet;
+
+    DeclExpr* declOf(VarExpr* ve)
+    {
+        if (DeclExpr* de = node_cast<DeclExpr*>(ve))
+            return de;
+        return ve->sco->getVarDef(ve->Name());
+    }
+
+    bool intersects(const DeclSet& l, const DeclSet& r)
+    {
+        for (auto d : l)
+            if (r.count(d))
+                return true;
+        return false;
+    }
+
+    //everything an implied loop's body touches
+    struct LoopAccess
+    {
+        DeclSet domain; //lists it iterates over
+        int length; //how many times it runs, if they're all fixed length lists. otherwise 0
+        DeclSet elemWrites; //`x = ...
+        DeclSet scalarWrites; //x = ...
+        DeclSet wholeReads; //x, but not `x
+        DeclSet elemReads; //`x
+        bool unknown; //calls, or writes we can't pin down
+
+        LoopAccess(ImpliedLoopStmt* il);
+
+        bool refs(const DeclSet& ds) const
+        {
+            return intersects(ds, elemWrites) || intersects(ds, scalarWrites)
+                || intersects(ds, wholeReads) || intersects(ds, elemReads);
+        }
+
+    private:
+        void addWrite(Node0* lhs);
+    };
+
+    LoopAccess::LoopAccess(ImpliedLoopStmt* il)
+        : length(0), unknown(false)
+    {
+        //an aggregate's ` reads the whole list
+        std::unordered_set<Node0*> ownIters(il->targets.begin(), il->targets.end());
+
+        for (auto t : il->targets)
+        {
+            //lists that aren't variables could have any length
+            VarExpr* ve = node_cast<VarExpr*>(t->getChildA());
+            DeclExpr* de = ve ? declOf(ve) : nullptr;
+            if (de)
+                domain.insert(de);
+            else
+                unknown = true;
+
+            //it runs over the shortest list
+            typ::ListType lt = t->getChildA()->Type().getList();
+            int tlen = lt.isValid() ? lt.length() : 0;
+            if (t == il->targets.front())
+                length = tlen;
+            else if (!length || !tlen)
+                length = 0;
+            else
+                length = std::min(length, tlen);
+        }
+
+        for (auto n : Subtree<>(il->getChildA()))
+        {
+            switch (n->Kind())
+            {
+            case NodeKind::OverloadCallExpr: //a real function, who knows what it does
+                unknown = true;
+                break;
+
+            case NodeKind::AssignExpr:
+            case NodeKind::OpAssignExpr:
+                addWrite(static_cast<AssignExpr*>(n)->getChildA());
+                break;
+
+            case NodeKind::VarExpr:
+            case NodeKind::DeclExpr:
+            {
+                DeclExpr* de = declOf(static_cast<VarExpr*>(n));
+                if (!de)
+                    unknown = true;
+                else if (ownIters.count(n->parent))
+                    elemReads.insert(de);
+                else
+                    wholeReads.insert(de);
+                break;
+            }
+
+            default:
+                break;
+            }
+        }
+    }
+
+    void LoopAccess::addWrite(Node0* lhs)
+    {
+        //op assigns write through a temporary
+        while (TmpExpr* tmp = exact_cast<TmpExpr*>(lhs))
+            lhs = tmp->setBy;
+
+        if (IterExpr* ie = exact_cast<IterExpr*>(lhs))
+        {
+            VarExpr* ve = node_cast<VarExpr*>(ie->getChildA());
+            DeclExpr* de = ve ? declOf(ve) : nullptr;
+            if (de)
+                elemWrites.insert(de);
+            else
+                unknown = true;
+        }
+        else if (VarExpr* ve = node_cast<VarExpr*>(lhs))
+        {
+            DeclExpr* de = declOf(ve);
+            if (de)
+                scalarWrites.insert(de);
+            else
+                unknown = true;
+        }
+        else
+            unknown = true;
+    }
+
+    bool canFuse(const LoopAccess& l, const LoopAccess& r)
+    {
+        if (l.unknown || r.unknown)
+            return false;
+        if (l.domain != r.domain && (!l.length || l.length != r.length))
+            return false;
+
+        //something assigned as a whole would be seen half way through by the other loop
+        if (r.refs(l.scalarWrites) || l.refs(r.scalarWrites))
+            return false;
+
+        //both loops see the same element on the same iteration, so sharing elements
+        //is fine. looking at the whole list is not
+        if (intersects(l.elemWrites, r.wholeReads) || intersects(r.elemWrites, l.wholeReads))
+            return false;
+
+        return true;
+    }
+
+    bool independent(const LoopAccess& l)
+    {
+        //a scalar write is either a race or a value carried to the next iteration
+        return !l.unknown && l.scalarWrites.empty() && !intersects(l.elemWrites, l.wholeReads);
+    }
+
+    //the statement that runs right after n, if they're in the same list of statements
+    Node0* nextStmt(Node0* n)
+    {
+        while (StmtPair* sp = exact_cast<StmtPair*>(n->parent))
+        {
+            if (sp->getChildA() == n)
+            {
+                Node0* next = sp->getChildB();
+                while (StmtPair* inner = exact_cast<StmtPair*>(next))
+                    next = inner->getChildA();
+                return next;
+            }
+            n = sp;
+        }
+        return nullptr;
+    }
+
+    //move next's body onto the end of il's body, and take next out of the tree
+    void fuse(ImpliedLoopStmt* il, ImpliedLoopStmt* next)
+    {
+        Ptr body = next->detachChildA();
+        il->targets.insert(il->targets.end(), next->targets.begin(), next->targets.end());
+
+        //replace next's pair with the other half of it. this deletes next
+        StmtPair* sp = exact_cast<StmtPair*>(next->parent);
+        Ptr other = sp->getChildA() == next ? sp->detachChildB() : sp->detachChildA();
+        sp->parent->replaceChild(sp, move(other));
+
+        il->setChildA(Ptr(new StmtPair(il->detachChildA(), move(body))));
+    }
+}
+
+void sa::fuseImpliedLoops(Node0* root)
+{
+    std::unordered_set<ImpliedLoopStmt*> fusedAway;
+
+    for (auto il : Subtree<ImpliedLoopStmt>(root).cached())
+    {
+        if (fusedAway.count(il))
+            continue;
+
+        for (;;)
+        {
+            ImpliedLoopStmt* next = exact_cast<ImpliedLoopStmt*>(nextStmt(il));
+            if (!next || !canFuse(LoopAccess(il), LoopAccess(next)))
+                break;
+
+            if (Global().options.dumpFusion)
+                std::cerr << Global().srcMgr.expand(next->loc)
+                    << ": fused into implied loop at " << Global().srcMgr.expand(il->loc) << '\n';
+
+            fusedAway.insert(next);
+            fuse(il, next);
+        }
+    }
+}
+
+void sa::markParallelLoops(Node0* root)
+{
+    if (!Global().options.parallel)
+        return;
+
+    for (auto il : Subtree<ImpliedLoopStmt>(root))
+    {
+        //tensors already get a loop nest of their own
+        if (!il->targets.front()->getChildA()->Type().getList().isValid())
+            continue;
+        il->parallel = independent(LoopAccess(il));
+
+        if (Global().options.dumpFusion && il->parallel)
+            std::cerr << Global().srcMgr.expand(il->loc) << ": implied loop runs in parallel\n";
+    }
+}
@@ -3,7 +3,6 @@
 #include "Global.h"
 
 #include <utility>
-#include <fstream>
 
 using namespace ast;
 
@@ -19,30 +18,22 @@ Module::Module(std::string fname)
 
     fileName(fname)
 {
-    std::ifstream t(fileName.c_str(), std::ios_base::in | std::ios_base::binary); //to keep CR / CRLF from messing us up
+    arena = &nodeArena; //we aren't in our own arena, but our annotation should be
+    source = Global().srcMgr.load(fileName);
 
-    if (!t.is_open())
+    if (!source)
     {
         err::Error(tok::Location()) << "Could not open file '" << fileName << '\'';
         throw err::FatalError(); //just give up instead of printing 100000 useless errors
     }
 
-    t.seekg(0, std::ios::end);
-    std::streamoff size = t.tellg();
-    buffer = new char[(size_t)size + 1];
-
-    t.seekg(0);
-    t.read(buffer, size);
-    buffer[size] = 0;
-
-    fileName = fileName.substr(fileName.find_last_of('\\') + 1);
-    fileName = fileName.substr(fileName.find_last_of('/') + 1); //portability!
+    fileName = source->name();
 }
 
 Module::~Module()
 {
-    delete[] buffer;
     detachChildA(); //delete the nodes manually before the scopes get deleted
+    Annot().reset(); //and before the arena does
 }
 
 void Module::PublicImport(Module* other)
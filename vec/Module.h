@@ -3,6 +3,7 @@
 
 #include "AstNode.h"
 #include "Scope.h"
+#include "SourceManager.h"
 
 #include <map>
 #include <list>
@@ -18,9 +19,16 @@ namespace ast
 {
     struct Module : public Node1
     {
+        static const NodeKind kind = NodeKind::Module;
+        NodeKind myKind() {return kind;}
+
         Module(std::string fname);
         ~Module();
 
+        //every node in this module lives here. make it current with a utl::ArenaGuard
+        //before creating nodes for this module
+        utl::Arena nodeArena;
+
         void PublicImport(Module* other);
         void PublicUnImport(Module* other);
         void PrivateImport(Module* other);
@@ -50,7 +58,7 @@ namespace ast
 
         std::string myLbl() {return "Comp Unit";}
 
-        char * buffer;
+        const tok::SourceBuffer* source; //owned by Global().srcMgr
         std::string fileName;
     };
 }
@@ -0,0 +1,1214 @@
+#include "ModuleCache.h"
+#include "Module.h"
+#include "SemaNodes.h"
+#include "Value.h"
+#include "Global.h"
+
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <chrono>
+#include <unordered_map>
+#include <cstring>
+#include <cstdio>
+#include <cstdint>
+#include <cassert>
+
+#ifdef _WIN32
+#include <direct.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#else
+#include <sys/stat.h>
+#endif
+
+using namespace ast;
+
+//anything that changes what Phase1 produces, or how it's written out here, has to change
+//this. a relinked vc changes the key on its own, see compilerKey
+#define CACHE_VERSION "vec module cache 1, built " __DATE__ " " __TIME__
+
+//an entry is laid out as
+//  header: magic, key, size of the source, checksum of the rest
+//  identifiers, as strings
+//  types, as a typ::TypeTable
+//  body: module name, scopes, the tree in preorder, the links between nodes that aren't
+//  parent and child, var defs of each scope, extern types
+//entries are only ever read by the machine that wrote them, so nothing is byte swapped
+
+namespace
+{
+    typedef std::chrono::high_resolution_clock Clock;
+
+    double millis(Clock::duration d)
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(d).count() / 1000.;
+    }
+
+    const char magic[4] = {'v', 'c', 'm', 'c'};
+
+    //FNV-1a, 64 bit
+    void fnv(uint64_t& h, const char* b, size_t len)
+    {
+        for (size_t i = 0; i < len; ++i)
+        {
+            h ^= (unsigned char)b[i];
+            h *= 1099511628211ull;
+        }
+    }
+
+    //the version, and the size and modification time of the running vc. __DATE__ and
+    //__TIME__ would only change when this file is rebuilt, not when something it reads
+    //from is. if vc can't be found the build time is all there is
+    uint64_t compilerKey()
+    {
+        uint64_t h = 14695981039346656037ull;
+        fnv(h, CACHE_VERSION, sizeof(CACHE_VERSION)); //the nuls keep the parts apart
+#ifdef _WIN32
+        char* path = nullptr;
+        struct _stat64 st;
+        bool found = _get_pgmptr(&path) == 0 && path && _stat64(path, &st) == 0;
+#else
+        struct stat st;
+        bool found = stat("/proc/self/exe", &st) == 0;
+#endif
+        uint64_t size = found ? uint64_t(st.st_size) : 0;
+        uint64_t mtime = found ? uint64_t(st.st_mtime) : 0;
+        fnv(h, (const char*)&size, sizeof(size));
+        fnv(h, (const char*)&mtime, sizeof(mtime));
+        return h;
+    }
+
+    uint64_t keyFor(Module* mod, uint64_t compiler)
+    {
+        uint64_t h = compiler;
+        fnv(h, mod->name.c_str(), mod->name.size() + 1);
+        fnv(h, mod->fileName.c_str(), mod->fileName.size() + 1);
+        fnv(h, mod->source->begin(), mod->source->size());
+        return h;
+    }
+
+    struct Out
+    {
+        std::vector<char> buf;
+
+        void raw(const void* p, size_t n)
+        {
+            buf.insert(buf.end(), (const char*)p, (const char*)p + n);
+        }
+        void u8(unsigned char v) {buf.push_back(char(v));}
+        void u32(uint32_t v) {raw(&v, sizeof(v));}
+        void i32(int32_t v) {raw(&v, sizeof(v));}
+        void u64(uint64_t v) {raw(&v, sizeof(v));}
+        void str(const char* b, size_t len)
+        {
+            u32(uint32_t(len));
+            raw(b, len);
+        }
+    };
+
+    //once anything goes wrong, ok is false and everything reads as 0, so callers only
+    //have to check before they use what they read for something that matters
+    struct In
+    {
+        const char* cur;
+        const char* end;
+        bool ok;
+
+        In(const char* b, const char* e) : cur(b), end(e), ok(true) {}
+
+        void raw(void* p, size_t n)
+        {
+            if (!ok || size_t(end - cur) < n)
+            {
+                ok = false;
+                memset(p, 0, n);
+                return;
+            }
+            memcpy(p, cur, n);
+            cur += n;
+        }
+        unsigned char u8() {unsigned char v; raw(&v, sizeof(v)); return v;}
+        uint32_t u32() {uint32_t v; raw(&v, sizeof(v)); return v;}
+        int32_t i32() {int32_t v; raw(&v, sizeof(v)); return v;}
+        uint64_t u64() {uint64_t v; raw(&v, sizeof(v)); return v;}
+        std::string str()
+        {
+            uint32_t len = u32();
+            if (!ok || size_t(end - cur) < len)
+            {
+                ok = false;
+                return std::string();
+            }
+            std::string ret(cur, len);
+            cur += len;
+            return ret;
+        }
+    };
+
+    //the module's own scopes are numbered first, then the ones in mod->scopes
+    enum
+    {
+        SCOPE_PUB,
+        SCOPE_PRIV,
+        SCOPE_LIST
+    };
+
+    class Writer
+    {
+        Module* mod;
+        uint32_t base, limit; //locations in the module's source
+        bool ok;
+
+        Out body;
+        typ::TypeTable types;
+
+        std::unordered_map<int, uint32_t> identIdx;
+        std::vector<Ident> idents;
+
+        std::vector<NormalScope*> scopes;
+        std::unordered_map<NormalScope*, uint32_t> scopeIdx;
+
+        std::unordered_map<Node0*, uint32_t> nodeIdx; //preorder
+        std::vector<Node0*> linked; //nodes that refer to others, in preorder
+
+        void ident(Out& out, Ident id)
+        {
+            auto found = identIdx.find(id);
+            if (found == identIdx.end())
+            {
+                found = identIdx.insert(std::make_pair(int(id), uint32_t(idents.size()))).first;
+                idents.push_back(id);
+            }
+            out.u32(found->second);
+        }
+
+        void type(typ::Type t) {body.u32(types.add(t));}
+
+        //0 is still nowhere, everything else is relative to the start of the source
+        void pos(uint32_t p)
+        {
+            if (p == 0)
+                body.u32(0);
+            else if (p < base || p > limit)
+                ok = false;
+            else
+                body.u32(p - base + 1);
+        }
+
+        void loc(tok::Location l)
+        {
+            pos(l.begin);
+            pos(l.end);
+        }
+
+        void scope(NormalScope* s)
+        {
+            auto found = scopeIdx.find(s);
+            if (found == scopeIdx.end())
+                ok = false;
+            else
+                body.u32(found->second);
+        }
+
+        //0 is null, otherwise 1 + the node's index
+        void ref(Node0* n)
+        {
+            if (!n)
+            {
+                body.u32(0);
+                return;
+            }
+            auto found = nodeIdx.find(n);
+            if (found == nodeIdx.end())
+                ok = false; //not part of the tree
+            else
+                body.u32(found->second + 1);
+        }
+
+        template<class Node>
+        void refs(const std::vector<Node*>& ns)
+        {
+            body.u32(uint32_t(ns.size()));
+            for (auto n : ns)
+                ref(n);
+        }
+
+        void children(NodeN* n)
+        {
+            body.u32(uint32_t(n->Children().size()));
+            for (auto& c : n->Children())
+                node(c.get());
+        }
+
+        void typeDefs(NormalScope* s)
+        {
+            body.u32(uint32_t(s->typeDefs.size()));
+            for (auto& td : s->typeDefs)
+            {
+                ident(body, td.first);
+                body.u32(uint32_t(td.second.params.size()));
+                for (auto param : td.second.params)
+                    ident(body, param);
+                type(td.second.mapped);
+            }
+        }
+
+        void node(Node0* n);
+        void link(Node0* n);
+
+    public:
+        Writer(Module* mod);
+        bool write(std::vector<char>& out, uint64_t key);
+    };
+
+    Writer::Writer(Module* mod)
+        : mod(mod), ok(true)
+    {
+        base = mod->source->locationOf(mod->source->begin()).begin;
+        limit = mod->source->locationOf(mod->source->end()).end;
+
+        scopes.push_back(&mod->pub);
+        scopes.push_back(&mod->priv);
+        for (auto& s : mod->scopes)
+            scopes.push_back(&s);
+        for (uint32_t i = 0; i < scopes.size(); ++i)
+            scopeIdx[scopes[i]] = i;
+    }
+
+    void Writer::node(Node0* n)
+    {
+        //a hole in the tree only happens after errors
+        if (!n)
+        {
+            ok = false;
+            return;
+        }
+
+        uint32_t idx = uint32_t(nodeIdx.size());
+        nodeIdx[n] = idx;
+        NodeKind k = n->Kind();
+        body.u8((unsigned char)k);
+        loc(n->loc);
+
+        typ::Type t;
+        val::Value v;
+        if (n->ownAnnot(t, v))
+        {
+            body.u8(1);
+            type(t);
+            ok &= v.toBytes(body.buf);
+        }
+        else
+            body.u8(0);
+
+        switch (k)
+        {
+        case NodeKind::NullExpr:
+        {
+            const char* detail = static_cast<NullExpr*>(n)->detail;
+            body.u8(detail != nullptr);
+            if (detail)
+                body.str(detail, strlen(detail));
+            break;
+        }
+        case NodeKind::VarExpr:
+        case NodeKind::DeclExpr:
+        case NodeKind::IntrinDeclExpr:
+        {
+            VarExpr* ve = static_cast<VarExpr*>(n);
+            scope(ve->sco);
+            body.u8(ve->isOp);
+            if (ve->isOp)
+                body.u32(ve->Op());
+            else
+                ident(body, ve->Name());
+            if (k == NodeKind::IntrinDeclExpr)
+                body.i32(static_cast<IntrinDeclExpr*>(n)->intrin_id);
+            break;
+        }
+        case NodeKind::Lambda:
+        {
+            Lambda* lam = static_cast<Lambda*>(n);
+            ident(body, lam->name);
+            body.u32(uint32_t(lam->params.size()));
+            for (auto param : lam->params)
+                ident(body, param);
+            scope(lam->sco);
+            node(lam->getChildA());
+            break;
+        }
+        case NodeKind::ConstExpr:
+        case NodeKind::NullStmt:
+            break;
+        case NodeKind::AssignExpr:
+        case NodeKind::OpAssignExpr:
+        {
+            AssignExpr* ae = static_cast<AssignExpr*>(n);
+            loc(ae->opLoc);
+            if (k == NodeKind::OpAssignExpr)
+            {
+                OpAssignExpr* oae = static_cast<OpAssignExpr*>(n);
+                body.u32(oae->assignOp);
+                scope(oae->sco);
+            }
+            node(ae->getChildA());
+            node(ae->getChildB());
+            break;
+        }
+        case NodeKind::OverloadCallExpr:
+        case NodeKind::TupAccExpr:
+        case NodeKind::ListAccExpr:
+        {
+            OverloadCallExpr* call = static_cast<OverloadCallExpr*>(n);
+            //ovrResult isn't set until Exec
+            if (!exact_cast<VarExpr*>(call->fun.get()))
+                ok = false;
+            else
+                node(call->fun.get());
+            children(call);
+            break;
+        }
+        case NodeKind::AggExpr:
+        {
+            AggExpr* agg = static_cast<AggExpr*>(n);
+            body.u32(agg->op);
+            scope(agg->sco);
+            body.i32(agg->combineOp);
+            node(agg->getChildA());
+            linked.push_back(n);
+            break;
+        }
+        case NodeKind::PostExpr:
+            body.u32(static_cast<PostExpr*>(n)->op);
+            node(static_cast<PostExpr*>(n)->getChildA());
+            break;
+        case NodeKind::Block:
+            scope(static_cast<Block*>(n)->scope);
+            node(static_cast<Block*>(n)->getChildA());
+            break;
+        case NodeKind::IterExpr:
+        case NodeKind::ExprStmt:
+        case NodeKind::ReturnStmt:
+            node(static_cast<Node1*>(n)->getChildA());
+            break;
+        case NodeKind::StmtPair:
+        case NodeKind::IfStmt:
+        case NodeKind::SwitchStmt:
+        case NodeKind::WhileStmt:
+            node(static_cast<Node2*>(n)->getChildA());
+            node(static_cast<Node2*>(n)->getChildB());
+            break;
+        case NodeKind::IfElseStmt:
+            node(static_cast<Node3*>(n)->getChildA());
+            node(static_cast<Node3*>(n)->getChildB());
+            node(static_cast<Node3*>(n)->getChildC());
+            break;
+        case NodeKind::ListifyExpr:
+        case NodeKind::TuplifyExpr:
+        case NodeKind::RhoStmt:
+            children(static_cast<NodeN*>(n));
+            break;
+        case NodeKind::TmpExpr:
+        case NodeKind::PhiExpr:
+            linked.push_back(n);
+            break;
+        case NodeKind::BranchStmt:
+            node(static_cast<BranchStmt*>(n)->getChildA());
+            linked.push_back(n);
+            break;
+        case NodeKind::ImpliedLoopStmt:
+            body.u8(static_cast<ImpliedLoopStmt*>(n)->parallel);
+            node(static_cast<ImpliedLoopStmt*>(n)->getChildA());
+            linked.push_back(n);
+            break;
+        default: //the rest are made by Exec
+            ok = false;
+            break;
+        }
+    }
+
+    void Writer::link(Node0* n)
+    {
+        body.u32(nodeIdx[n]);
+        switch (n->Kind())
+        {
+        case NodeKind::TmpExpr:
+            ref(static_cast<TmpExpr*>(n)->setBy);
+            break;
+        case NodeKind::PhiExpr:
+            refs(static_cast<PhiExpr*>(n)->inputs);
+            break;
+        case NodeKind::BranchStmt:
+            ref(static_cast<BranchStmt*>(n)->ifTrue);
+            ref(static_cast<BranchStmt*>(n)->ifFalse);
+            break;
+        case NodeKind::ImpliedLoopStmt:
+            refs(static_cast<ImpliedLoopStmt*>(n)->targets);
+            break;
+        case NodeKind::AggExpr:
+            refs(static_cast<AggExpr*>(n)->targets);
+            break;
+        default:
+            assert(false && "node doesn't link to anything");
+        }
+    }
+
+    bool Writer::write(std::vector<char>& out, uint64_t key)
+    {
+        body.str(mod->name.data(), mod->name.size());
+
+        body.u32(uint32_t(mod->scopes.size()));
+        for (uint32_t i = 0; i < scopes.size(); ++i)
+        {
+            if (i >= SCOPE_LIST)
+            {
+                auto parent = scopeIdx.find(dynamic_cast<NormalScope*>(scopes[i]->getParent()));
+                if (parent == scopeIdx.end() || parent->second >= i)
+                    return false;
+                body.u32(parent->second);
+            }
+            typeDefs(scopes[i]);
+        }
+
+        node(mod->getChildA());
+
+        body.u32(uint32_t(linked.size()));
+        for (auto n : linked)
+            link(n);
+
+        for (auto s : scopes)
+            refs(s->varDefs);
+
+        body.u32(uint32_t(mod->externTypes.size()));
+        for (auto& ext : mod->externTypes)
+        {
+            type(ext.first);
+            loc(ext.second.nameLoc);
+            loc(ext.second.argsLoc);
+        }
+
+        if (!ok)
+            return false;
+
+        //types have idents in them, so they go before the idents are written out
+        Out typeOut;
+        typeOut.u32(uint32_t(types.size()));
+        for (auto& e : types.entries)
+        {
+            typeOut.u8((unsigned char)e.kind);
+            typeOut.i32(e.a);
+            typeOut.i32(e.b);
+            ident(typeOut, e.name);
+            typeOut.u32(uint32_t(e.elems.size()));
+            for (auto& elem : e.elems)
+            {
+                typeOut.i32(elem.first);
+                ident(typeOut, elem.second);
+            }
+        }
+
+        Out rest;
+        rest.u32(uint32_t(idents.size()));
+        for (auto id : idents)
+        {
+            utl::weak_string str = Global().getIdent(id);
+            rest.str(str.begin(), str.length());
+        }
+        rest.raw(typeOut.buf.data(), typeOut.buf.size());
+        rest.raw(body.buf.data(), body.buf.size());
+
+        uint64_t sum = 14695981039346656037ull;
+        fnv(sum, rest.buf.data(), rest.buf.size());
+
+        Out head;
+        head.raw(magic, sizeof(magic));
+        head.u64(key);
+        head.u64(mod->source->size());
+        head.u64(sum);
+
+        out.swap(head.buf);
+        out.insert(out.end(), rest.buf.begin(), rest.buf.end());
+        return true;
+    }
+
+    class Reader
+    {
+        Module* mod;
+        In in;
+        uint32_t base, limit;
+
+        std::vector<Ident> idents;
+        typ::TypeTable types;
+        std::vector<NormalScope*> scopes;
+        std::vector<Node0*> nodes; //preorder
+
+        Ident ident()
+        {
+            uint32_t idx = in.u32();
+            if (idx >= idents.size())
+            {
+                in.ok = false;
+                return Global().reserved.null;
+            }
+            return idents[idx];
+        }
+
+        typ::Type type()
+        {
+            uint32_t idx = in.u32();
+            if (idx >= types.size())
+            {
+                in.ok = false;
+                return typ::error;
+            }
+            return types.get(idx);
+        }
+
+        uint32_t pos()
+        {
+            uint32_t p = in.u32();
+            if (p == 0)
+                return 0;
+            if (p > limit - base + 1)
+                in.ok = false;
+            return p + base - 1;
+        }
+
+        tok::Location loc()
+        {
+            uint32_t begin = pos();
+            return tok::Location(begin, pos());
+        }
+
+        NormalScope* scope()
+        {
+            uint32_t idx = in.u32();
+            if (idx >= scopes.size())
+            {
+                in.ok = false;
+                return nullptr;
+            }
+            return scopes[idx];
+        }
+
+        //the node a Writer::ref refers to. null is only allowed if it's nullable
+        Node0* ref(bool nullable)
+        {
+            uint32_t idx = in.u32();
+            if (idx == 0 && nullable)
+                return nullptr;
+            if (idx == 0 || idx > nodes.size())
+            {
+                in.ok = false;
+                return nullptr;
+            }
+            return nodes[idx - 1];
+        }
+
+        //likewise, but it also has to be a Node
+        template<class Node>
+        Node* ref(bool nullable)
+        {
+            Node0* n = ref(nullable);
+            Node* ret = node_cast<Node*>(n);
+            if (n && !ret)
+                in.ok = false;
+            return ret;
+        }
+
+        template<class Node>
+        void refs(std::vector<Node*>& out)
+        {
+            uint32_t size = in.u32();
+            for (uint32_t i = 0; i < size && in.ok; ++i)
+                out.push_back(ref<Node>(false));
+        }
+
+        std::vector<Ptr> children()
+        {
+            std::vector<Ptr> ret;
+            uint32_t size = in.u32();
+            for (uint32_t i = 0; i < size && in.ok; ++i)
+                ret.push_back(node());
+            return ret;
+        }
+
+        //NodeNs are made with a stand in child, which is replaced here
+        template<class Node>
+        Node* fill(Node* n, std::vector<Ptr>& kids)
+        {
+            n->clear();
+            for (auto& kid : kids)
+                n->appendChild(move(kid));
+            return n;
+        }
+
+        Ptr standIn(tok::Location& l) {return Ptr(new NullStmt(l));}
+
+        void typeDefs(NormalScope* s, std::map<Ident, TypeDef>& out)
+        {
+            uint32_t size = in.u32();
+            for (uint32_t i = 0; i < size && in.ok; ++i)
+            {
+                Ident name = ident();
+                TypeDef& td = out[name];
+                uint32_t params = in.u32();
+                for (uint32_t p = 0; p < params && in.ok; ++p)
+                    td.params.push_back(ident());
+                td.mapped = type();
+            }
+        }
+
+        Ptr node();
+        void link();
+        bool header(uint64_t key);
+
+    public:
+        Reader(Module* mod, const std::vector<char>& buf);
+        bool read(uint64_t key);
+    };
+
+    Reader::Reader(Module* mod, const std::vector<char>& buf)
+        : mod(mod), in(buf.data(), buf.data() + buf.size())
+    {
+        base = mod->source->locationOf(mod->source->begin()).begin;
+        limit = mod->source->locationOf(mod->source->end()).end;
+    }
+
+    Ptr Reader::node()
+    {
+        NodeKind k = NodeKind(in.u8());
+        size_t idx = nodes.size();
+        nodes.push_back(nullptr);
+        tok::Location l = loc();
+
+        bool annotated = in.u8() != 0;
+        typ::Type t;
+        val::Value v;
+        if (annotated)
+        {
+            t = type();
+            if (in.ok && !val::Value::fromBytes(in.cur, in.end, v))
+                in.ok = false;
+        }
+
+        //nothing can be made out of garbage, so check before each constructor
+        if (!in.ok)
+            return nullptr;
+
+        tok::Token o;
+        o.loc = l;
+        Ptr ret;
+
+        switch (k)
+        {
+        case NodeKind::NullExpr:
+        {
+            const char* detail = nullptr;
+            if (in.u8())
+            {
+                //the originals are string literals. this lives as long as they would need to
+                std::string str = in.str();
+                char* stored = static_cast<char*>(mod->nodeArena.allocate(str.size() + 1));
+                memcpy(stored, str.c_str(), str.size() + 1);
+                detail = stored;
+            }
+            if (!in.ok)
+                return nullptr;
+            ret.reset(new NullExpr(detail));
+            break;
+        }
+        case NodeKind::VarExpr:
+        case NodeKind::DeclExpr:
+        case NodeKind::IntrinDeclExpr:
+        {
+            NormalScope* s = scope();
+            bool isOp = in.u8() != 0;
+            if (isOp)
+            {
+                o.type = tok::TokenType(in.u32());
+                if (!in.ok || k != NodeKind::VarExpr)
+                    return nullptr;
+                ret.reset(new VarExpr(o, s));
+                break;
+            }
+
+            Ident name = ident();
+            int intrin_id = k == NodeKind::IntrinDeclExpr ? in.i32() : 0;
+            if (!in.ok)
+                return nullptr;
+
+            if (k == NodeKind::VarExpr)
+                ret.reset(new VarExpr(name, s, l));
+            else
+            {
+                ret.reset(new DeclExpr(name, s, t, l));
+                if (k == NodeKind::IntrinDeclExpr)
+                    ret.reset(new IntrinDeclExpr(static_cast<DeclExpr*>(ret.get()), intrin_id));
+            }
+            break;
+        }
+        case NodeKind::Lambda:
+        {
+            Ident name = ident();
+            std::vector<Ident> params;
+            uint32_t numParams = in.u32();
+            for (uint32_t i = 0; i < numParams && in.ok; ++i)
+                params.push_back(ident());
+            NormalScope* s = scope();
+            Ptr conts = node();
+            if (!in.ok)
+                return nullptr;
+            ret.reset(new Lambda(name, move(params), s, move(conts)));
+            break;
+        }
+        case NodeKind::ConstExpr:
+            ret.reset(new ConstExpr(l));
+            break;
+        case NodeKind::NullStmt:
+            ret.reset(new NullStmt(l));
+            break;
+        case NodeKind::AssignExpr:
+        case NodeKind::OpAssignExpr:
+        {
+            tok::Location opLoc = loc();
+            NormalScope* s = nullptr;
+            if (k == NodeKind::OpAssignExpr)
+            {
+                o.value.op = tok::TokenType(in.u32());
+                s = scope();
+            }
+            Ptr lhs = node();
+            Ptr rhs = node();
+            if (!in.ok)
+                return nullptr;
+            if (k == NodeKind::AssignExpr)
+                ret.reset(new AssignExpr(move(lhs), move(rhs), opLoc));
+            else
+            {
+                o.loc = opLoc;
+                ret.reset(new OpAssignExpr(move(lhs), move(rhs), o, s));
+            }
+            break;
+        }
+        case NodeKind::OverloadCallExpr:
+        case NodeKind::TupAccExpr:
+        case NodeKind::ListAccExpr:
+        {
+            Ptr fun = node();
+            std::vector<Ptr> kids = children();
+            if (!in.ok || !exact_cast<VarExpr*>(fun.get()))
+                return nullptr;
+
+            auto funPtr = MkNPtr(static_cast<VarExpr*>(fun.release()));
+            OverloadCallExpr* call;
+            if (k == NodeKind::OverloadCallExpr)
+                call = new OverloadCallExpr(move(funPtr), standIn(l), l);
+            else
+            {
+                o.type = funPtr->Op();
+                if (k == NodeKind::TupAccExpr)
+                    call = new TupAccExpr(standIn(l), standIn(l), o, funPtr->sco);
+                else
+                    call = new ListAccExpr(standIn(l), standIn(l), o, funPtr->sco);
+                call->fun = move(funPtr);
+            }
+            ret.reset(fill(call, kids));
+            break;
+        }
+        case NodeKind::AggExpr:
+        {
+            o.value.op = tok::TokenType(in.u32());
+            NormalScope* s = scope();
+            int combineOp = in.i32();
+            Ptr arg = node();
+            if (!in.ok)
+                return nullptr;
+            AggExpr* agg = new AggExpr(move(arg), o, s);
+            agg->combineOp = combineOp;
+            ret.reset(agg);
+            break;
+        }
+        case NodeKind::PostExpr:
+        {
+            o.type = tok::TokenType(in.u32());
+            Ptr arg = node();
+            if (!in.ok)
+                return nullptr;
+            ret.reset(new PostExpr(move(arg), o));
+            break;
+        }
+        case NodeKind::Block:
+        {
+            NormalScope* s = scope();
+            Ptr conts = node();
+            if (!in.ok)
+                return nullptr;
+            ret.reset(new Block(move(conts), s, l));
+            break;
+        }
+        case NodeKind::IterExpr:
+        case NodeKind::ExprStmt:
+        case NodeKind::ReturnStmt:
+        case NodeKind::BranchStmt:
+        {
+            Ptr a = node();
+            if (!in.ok)
+                return nullptr;
+            if (k == NodeKind::IterExpr)
+                ret.reset(new IterExpr(move(a), o));
+            else if (k == NodeKind::ExprStmt)
+                ret.reset(new ExprStmt(move(a)));
+            else if (k == NodeKind::ReturnStmt)
+                ret.reset(new ReturnStmt(move(a)));
+            else
+                ret.reset(new BranchStmt(move(a))); //branches are linked up later
+            break;
+        }
+        case NodeKind::StmtPair:
+        case NodeKind::IfStmt:
+        case NodeKind::SwitchStmt:
+        case NodeKind::WhileStmt:
+        {
+            Ptr a = node();
+            Ptr b = node();
+            if (!in.ok)
+                return nullptr;
+            if (k == NodeKind::StmtPair)
+                ret.reset(new StmtPair(move(a), move(b)));
+            else if (k == NodeKind::IfStmt)
+                ret.reset(new IfStmt(move(a), move(b), o));
+            else if (k == NodeKind::SwitchStmt)
+                ret.reset(new SwitchStmt(move(a), move(b), o));
+            else
+                ret.reset(new WhileStmt(move(a), move(b), o));
+            break;
+        }
+        case NodeKind::IfElseStmt:
+        {
+            Ptr a = node();
+            Ptr b = node();
+            Ptr c = node();
+            if (!in.ok)
+                return nullptr;
+            ret.reset(new IfElseStmt(move(a), move(b), move(c), o));
+            break;
+        }
+        case NodeKind::ListifyExpr:
+        case NodeKind::TuplifyExpr:
+        case NodeKind::RhoStmt:
+        {
+            std::vector<Ptr> kids = children();
+            if (!in.ok)
+                return nullptr;
+            if (k == NodeKind::ListifyExpr)
+                ret.reset(fill(new ListifyExpr(standIn(l)), kids));
+            else if (k == NodeKind::TuplifyExpr)
+                ret.reset(fill(new TuplifyExpr(standIn(l)), kids));
+            else
+                ret.reset(fill(new RhoStmt(), kids));
+            break;
+        }
+        case NodeKind::TmpExpr:
+            ret.reset(new TmpExpr(mod)); //linked up later
+            break;
+        case NodeKind::PhiExpr:
+            ret.reset(new PhiExpr(l));
+            break;
+        case NodeKind::ImpliedLoopStmt:
+        {
+            bool parallel = in.u8() != 0;
+            Ptr a = node();
+            if (!in.ok)
+                return nullptr;
+            ImpliedLoopStmt* il = new ImpliedLoopStmt(move(a));
+            il->parallel = parallel;
+            ret.reset(il);
+            break;
+        }
+        default:
+            in.ok = false;
+            return nullptr;
+        }
+
+        //constructors work out some locations from their children; use the real ones
+        ret->loc = l;
+        if (annotated)
+            ret->setOwnAnnot(t, v);
+        nodes[idx] = ret.get();
+        return ret;
+    }
+
+    void Reader::link()
+    {
+        uint32_t idx = in.u32();
+        if (!in.ok || idx >= nodes.size())
+        {
+            in.ok = false;
+            return;
+        }
+
+        Node0* n = nodes[idx];
+        switch (n->Kind())
+        {
+        case NodeKind::TmpExpr:
+        {
+            Node0* setBy = ref(false);
+            if (in.ok)
+                static_cast<TmpExpr*>(n)->setBy = setBy;
+            break;
+        }
+        case NodeKind::PhiExpr:
+            refs(static_cast<PhiExpr*>(n)->inputs);
+            break;
+        case NodeKind::BranchStmt:
+        {
+            BranchStmt* br = static_cast<BranchStmt*>(n);
+            br->ifTrue = ref<BranchStmt>(true);
+            br->ifFalse = ref<BranchStmt>(true);
+            break;
+        }
+        case NodeKind::ImpliedLoopStmt:
+            refs(static_cast<ImpliedLoopStmt*>(n)->targets);
+            break;
+        case NodeKind::AggExpr:
+            refs(static_cast<AggExpr*>(n)->targets);
+            break;
+        default:
+            in.ok = false;
+            break;
+        }
+    }
+
+    bool Reader::header(uint64_t key)
+    {
+        char m[sizeof(magic)];
+        in.raw(m, sizeof(m));
+        if (memcmp(m, magic, sizeof(magic)) != 0 || in.u64() != key
+            || in.u64() != mod->source->size())
+            return false;
+
+        //a damaged entry could still make sense, so it's checked as a whole first
+        uint64_t expected = in.u64();
+        uint64_t sum = 14695981039346656037ull;
+        fnv(sum, in.cur, in.end - in.cur);
+        if (!in.ok || sum != expected)
+            return false;
+
+        uint32_t numIdents = in.u32();
+        for (uint32_t i = 0; i < numIdents && in.ok; ++i)
+            idents.push_back(Global().addIdent(in.str()));
+
+        uint32_t numTypes = in.u32();
+        for (uint32_t i = 0; i < numTypes && in.ok; ++i)
+        {
+            typ::TypeTable::Entry e;
+            e.kind = typ::TypeTable::Kind(in.u8());
+            e.a = in.i32();
+            e.b = in.i32();
+            e.name = ident();
+            uint32_t numElems = in.u32();
+            for (uint32_t j = 0; j < numElems && in.ok; ++j)
+            {
+                int elem = in.i32();
+                e.elems.emplace_back(elem, ident());
+            }
+            types.entries.push_back(std::move(e));
+        }
+
+        return in.ok && types.build();
+    }
+
+    bool Reader::read(uint64_t key)
+    {
+        if (!header(key))
+            return false;
+
+        std::string name = in.str();
+
+        //scopes have to exist before the nodes that point to them, so make them now and
+        //take them back out if something goes wrong
+        size_t oldScopes = mod->scopes.size();
+        scopes.push_back(&mod->pub);
+        scopes.push_back(&mod->priv);
+
+        std::vector<std::map<Ident, TypeDef>> defs;
+        uint32_t numScopes = SCOPE_LIST + in.u32();
+        for (uint32_t i = 0; i < numScopes && in.ok; ++i)
+        {
+            if (i >= SCOPE_LIST)
+            {
+                uint32_t parent = in.u32();
+                if (!in.ok || parent >= i)
+                {
+                    in.ok = false;
+                    break;
+                }
+                mod->scopes.emplace_back(scopes[parent]);
+                scopes.push_back(&mod->scopes.back());
+            }
+            defs.emplace_back();
+            typeDefs(scopes[i], defs.back());
+        }
+
+        Ptr root;
+        if (in.ok)
+            root = node();
+
+        uint32_t numLinked = in.u32();
+        for (uint32_t i = 0; i < numLinked && in.ok; ++i)
+            link();
+
+        std::vector<std::vector<DeclExpr*>> varDefs(scopes.size());
+        for (auto& vd : varDefs)
+            refs(vd);
+
+        std::map<typ::Type, Module::ExternTypeInfo> externTypes;
+        uint32_t numExtern = in.u32();
+        for (uint32_t i = 0; i < numExtern && in.ok; ++i)
+        {
+            typ::Type t = type();
+            tok::Location nameLoc = loc();
+            tok::Location argsLoc = loc();
+            externTypes[t] = Module::ExternTypeInfo(nameLoc, argsLoc);
+        }
+
+        if (!in.ok || !root || in.cur != in.end)
+        {
+            //the nodes take themselves out of their scopes on the way
+            root.reset();
+            while (mod->scopes.size() > oldScopes)
+                mod->scopes.pop_back();
+            return false;
+        }
+
+        mod->name = name;
+        mod->setChildA(move(root));
+        for (size_t i = 0; i < scopes.size(); ++i)
+        {
+            scopes[i]->typeDefs.insert(defs[i].begin(), defs[i].end());
+            scopes[i]->resetVarDefs(varDefs[i]);
+        }
+        mod->externTypes.insert(externTypes.begin(), externTypes.end());
+        return true;
+    }
+}
+
+void ModuleCache::setDir(const std::string& d)
+{
+    dir = d;
+    compiler = compilerKey();
+}
+
+std::string ModuleCache::entryPath(uint64_t key)
+{
+    std::ostringstream path;
+    path << dir << '/' << std::hex << std::setfill('0') << std::setw(16) << key << ".vcm";
+    return path.str();
+}
+
+bool ModuleCache::load(Module* mod)
+{
+    if (!enabled())
+        return false;
+
+    Clock::time_point start = Clock::now();
+    Record rec = {mod, mod->name, keyFor(mod, compiler), false, false, 0};
+
+    std::ifstream file(entryPath(rec.key).c_str(), std::ios::binary);
+    if (file)
+    {
+        std::vector<char> buf((std::istreambuf_iterator<char>(file)),
+            std::istreambuf_iterator<char>());
+        Reader r(mod, buf);
+        rec.hit = r.read(rec.key);
+    }
+
+    if (rec.hit)
+    {
+        rec.millis = millis(Clock::now() - start);
+        rec.module = mod->name;
+    }
+
+    std::lock_guard<std::mutex> lock(recordsMutex);
+    records.push_back(rec);
+    return rec.hit;
+}
+
+void ModuleCache::store(Module* mod)
+{
+    if (!enabled())
+        return;
+
+    Record* rec = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(recordsMutex);
+        for (auto& r : records)
+            if (r.mod == mod)
+                rec = &r;
+    }
+    assert(rec && !rec->hit && "storing a module that wasn't missed");
+    rec->module = mod->name;
+    Clock::time_point start = Clock::now();
+
+    //not keyFor again, parsing can change the module's name
+    std::string path = entryPath(rec->key);
+    std::vector<char> buf;
+    Writer w(mod);
+    if (!w.write(buf, rec->key))
+        return;
+
+#ifdef _WIN32
+    _mkdir(dir.c_str());
+#else
+    mkdir(dir.c_str(), 0777);
+#endif
+
+    //write it somewhere else first so nobody reads half of it
+    std::ostringstream tmp;
+    tmp << path << '.' << Clock::now().time_since_epoch().count() << ".tmp";
+    {
+        std::ofstream file(tmp.str().c_str(), std::ios::binary);
+        if (!file.write(buf.data(), buf.size()))
+            return;
+    }
+
+    if (std::rename(tmp.str().c_str(), path.c_str()) != 0)
+    {
+        //windows won't rename over an existing file
+        std::remove(path.c_str());
+        if (std::rename(tmp.str().c_str(), path.c_str()) != 0)
+        {
+            std::remove(tmp.str().c_str());
+            return;
+        }
+    }
+
+    rec->stored = true;
+    rec->millis = millis(Clock::now() - start);
+}
+
+void ModuleCache::printStats(std::ostream& os)
+{
+    if (!enabled())
+        return;
+
+    size_t hits = 0;
+    for (auto& rec : records)
+        hits += rec.hit;
+
+    os << "module cache (" << dir << "): " << hits << " hit" << (hits == 1 ? "" : "s") << ", "
+        << records.size() - hits << " miss" << (records.size() - hits == 1 ? "" : "es") << '\n';
+    for (auto& rec : records)
+    {
+        os << "  " << rec.module << ": ";
+        if (rec.hit)
+            os << "hit, loaded in " << rec.millis << " ms\n";
+        else if (rec.stored)
+            os << "miss, stored in " << rec.millis << " ms\n";
+        else
+            os << "miss, not stored\n";
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef MODULECACHE_H
+#define MODULECACHE_H
+
+#include <string>
+#include <list>
+#include <ostream>
+#include <cstdint>
+#include <mutex>
+
+namespace ast
+{
+    struct Module;
+
+    //keeps modules on disk the way they are after Phase1, so files that haven't changed
+    //don't have to be lexed, parsed and lowered again. entries are named by a hash of the
+    //compiler binary and the file's name and contents, so stale ones are never looked at.
+    //different modules can be loaded and stored from different threads
+    class ModuleCache
+    {
+        std::string dir; //empty if the cache is off
+        uint64_t compiler; //hash of the cache version and of vc itself, goes in every key
+
+        struct Record
+        {
+            Module* mod;
+            std::string module;
+            uint64_t key; //of the file as it was when the module was loaded
+            bool hit;
+            bool stored; //for misses
+            double millis; //to load a hit or store a miss
+        };
+        std::list<Record> records; //a list so threads can hold on to their own
+        std::mutex recordsMutex; //for adding to and looking through records
+
+        std::string entryPath(uint64_t key);
+
+    public:
+        ModuleCache() : compiler(0) {}
+
+        void setDir(const std::string& d);
+        bool enabled() {return !dir.empty();}
+
+        //fill in mod, which was just created, from its entry. on a miss (or an entry that
+        //can't be used) it returns false and leaves mod alone
+        bool load(Module* mod);
+
+        //make an entry for mod, which just went through Phase1 without errors. modules
+        //that can't be written out are skipped
+        void store(Module* mod);
+
+        //hits and misses, for --stats
+        void printStats(std::ostream& os);
+    };
+}
+
+#endif
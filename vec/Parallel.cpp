@@ -0,0 +1,65 @@
+#include "Parallel.h"
+
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <exception>
+
+using namespace utl;
+
+unsigned utl::numThreads(unsigned requested)
+{
+    if (requested)
+        return requested;
+
+    unsigned hw = std::thread::hardware_concurrency();
+    return hw ? hw : 1; //0 means it doesn't know
+}
+
+void utl::parallelFor(size_t n, unsigned threads, const std::function<void(size_t)>& body)
+{
+    threads = numThreads(threads);
+    if (threads > n)
+        threads = unsigned(n);
+
+    //not worth starting anything
+    if (threads <= 1)
+    {
+        for (size_t i = 0; i < n; ++i)
+            body(i);
+        return;
+    }
+
+    std::atomic<size_t> next(0);
+    std::mutex failureMutex;
+    std::exception_ptr failure;
+
+    auto work = [&] ()
+    {
+        for (size_t i = next++; i < n; i = next++)
+        {
+            try
+            {
+                body(i);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(failureMutex);
+                if (!failure)
+                    failure = std::current_exception();
+                next = n; //stop handing out indices
+            }
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < threads; ++t)
+        pool.push_back(std::thread(work));
+    work();
+    for (auto& t : pool)
+        t.join();
+
+    if (failure)
+        std::rethrow_exception(failure);
+}
@@ -0,0 +1,26 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <functional>
+#include <cstddef>
+
+//thread local storage for plain old data. msvc 2012 doesn't have thread_local
+#ifdef _MSC_VER
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
+namespace utl
+{
+    //requested, or one per processor if it's 0
+    unsigned numThreads(unsigned requested);
+
+    //call body(i) for each i in [0, n) on up to threads threads (see numThreads), including
+    //this one. indices are handed out one at a time, so a few slow ones don't hold up the
+    //rest. if body throws, no more indices are started and the first exception is thrown
+    //again here once everyone has stopped
+    void parallelFor(size_t n, unsigned threads, const std::function<void(size_t)>& body);
+}
+
+#endif
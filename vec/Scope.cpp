@@ -1,8 +1,71 @@
 #include "Scope.h"
 #include "Expr.h"
 
+#include <algorithm>
+
 using namespace ast;
 
+std::atomic<unsigned int> Scope::clock(0);
+std::atomic<unsigned int> Scope::cycleCuts(0);
+
+Scope::Scope()
+    : generation(++clock), watched(false)
+{}
+
+Scope::~Scope()
+{
+    //nothing can look through us anymore
+    for (auto dep : dependents)
+        dep->forget(this);
+}
+
+void Scope::removeDependent(Scope* s)
+{
+    auto it = std::find(dependents.begin(), dependents.end(), s);
+    if (it != dependents.end())
+        dependents.erase(it);
+}
+
+void Scope::invalidate()
+{
+    //if nothing was cached since last time, there's nothing to drop here or past here
+    if (!watched)
+        return;
+
+    watched = false;
+    generation = ++clock;
+    for (auto dep : dependents)
+        dep->invalidate();
+}
+
+NormalScope::NormalScope(Scope *p)
+    : parent(p)
+{
+    if (parent)
+        parent->addDependent(this);
+}
+
+NormalScope::~NormalScope()
+{
+    if (parent)
+        parent->removeDependent(this);
+}
+
+void NormalScope::forget(Scope* s)
+{
+    if (parent == s)
+        parent = nullptr;
+}
+
+void NormalScope::watch()
+{
+    if (watched)
+        return;
+    watched = true;
+    if (parent)
+        parent->watch();
+}
+
 void NormalScope::addTypeDef(Ident name, TypeDef &td)
 {
     typeDefs[name] = td;
@@ -25,19 +88,37 @@ TypeDef * NormalScope::getTypeDef(Ident name)
 void NormalScope::addVarDef(DeclExpr* decl)
 {
     varDefs.push_back(decl);
+    index[decl->Name()].push_back(decl);
+    invalidate();
 }
 
 void NormalScope::removeVarDef(DeclExpr* decl)
 {
     //erase remove the element that is now one past the end
     varDefs.erase(std::remove(varDefs.begin(), varDefs.end(), decl));
+
+    std::vector<DeclExpr*>& bucket = index[decl->Name()];
+    bucket.erase(std::remove(bucket.begin(), bucket.end(), decl), bucket.end());
+    invalidate();
+}
+
+void NormalScope::resetVarDefs(const std::vector<DeclExpr*>& defs)
+{
+    varDefs.clear();
+    index.clear();
+    for (auto decl : defs)
+    {
+        varDefs.push_back(decl);
+        index[decl->Name()].push_back(decl);
+    }
+    invalidate();
 }
 
 DeclExpr* NormalScope::getVarDef(Ident name)
 {
-    for (auto def : varDefs)
-        if (def->Name() == name)
-            return def;
+    auto it = index.find(name);
+    if (it != index.end() && it->second.size())
+        return it->second.front();
 
     if (parent)
         return parent->getVarDef(name);
@@ -45,17 +126,76 @@ DeclExpr* NormalScope::getVarDef(Ident name)
         return nullptr;
 }
 
-std::vector<DeclExpr*> NormalScope::getVarDefs(Ident name)
+void NormalScope::collectVarDefs(Ident name, std::vector<DeclExpr*>& out)
 {
-    std::vector<DeclExpr*> ret;
     if (parent)
-        ret = parent->getVarDefs(name);
+        parent->collectVarDefs(name, out);
+
+    auto it = index.find(name);
+    if (it != index.end())
+        out.insert(out.end(), it->second.begin(), it->second.end());
+}
+
+const std::vector<DeclExpr*>& NormalScope::getVarDefs(Ident name)
+{
+    CacheEntry& entry = lookupCache[name];
+    unsigned int gen = cacheGeneration();
+    if (entry.generation == gen)
+        return entry.defs;
+
+    unsigned int oldCuts = cycleCuts;
+    entry.defs.clear(); //keeps its capacity
+    collectVarDefs(name, entry.defs);
+
+    //0 is never a valid generation
+    entry.generation = oldCuts == cycleCuts ? gen : 0;
+    return entry.defs;
+}
+
+ImportScope::ImportScope(Scope *p)
+    : hasVisited(false)
+{
+    imports.push_back(p);
+    p->addDependent(this);
+}
 
-    for (auto def : varDefs)
-        if (def->Name() == name)
-            ret.push_back(def);
+ImportScope::~ImportScope()
+{
+    for (auto scope : imports)
+        scope->removeDependent(this);
+}
 
-    return ret;
+void ImportScope::Import(Scope* other)
+{
+    imports.push_back(other);
+    other->addDependent(this);
+    //other may not be watched, so anything cached here can't be trusted
+    invalidate();
+}
+
+void ImportScope::UnImport(Scope* other)
+{
+    //just the one, it may have been imported twice
+    auto it = std::find(imports.begin(), imports.end(), other);
+    if (it == imports.end())
+        return;
+    imports.erase(it);
+    other->removeDependent(this);
+    invalidate();
+}
+
+void ImportScope::forget(Scope* s)
+{
+    imports.remove(s);
+}
+
+void ImportScope::watch()
+{
+    if (watched)
+        return;
+    watched = true;
+    for (auto scope : imports)
+        scope->watch();
 }
 
 DeclExpr* ImportScope::getVarDef(Ident name)
@@ -79,23 +219,20 @@ DeclExpr* ImportScope::getVarDef(Ident name)
     return nullptr;
 }
 
-std::vector<DeclExpr*> ImportScope::getVarDefs(Ident name)
+void ImportScope::collectVarDefs(Ident name, std::vector<DeclExpr*>& out)
 {
     //don't cycle
     if (hasVisited)
-        return std::vector<DeclExpr*>();
+    {
+        ++cycleCuts;
+        return;
+    }
     hasVisited = true;
 
-    std::vector<DeclExpr*> ret;
-
     for (auto scope : imports)
-    {
-        std::vector<DeclExpr*> defs = scope->getVarDefs(name);
-        ret.insert(ret.end(), defs.begin(), defs.end());
-    }
+        scope->collectVarDefs(name, out);
 
     hasVisited = false;
-    return ret;
 }
 
 TypeDef * ImportScope::getTypeDef(Ident name)
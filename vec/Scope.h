@@ -4,6 +4,8 @@
 #include "Type.h"
 #include <vector>
 #include <map>
+#include <unordered_map>
+#include <atomic>
 
 namespace ast
 {
@@ -15,36 +17,101 @@ namespace ast
         typ::Type mapped;
     };
 
+    //lookups made from a scope are cached with its generation, which changes whenever the
+    //scope or anything visible from it does. changes are pushed to the scopes that look
+    //through the changed one (its children and importers), but only as far as something
+    //has been cached, so declaring things while parsing costs nothing extra. modules
+    //being parsed at the same time can't see each other's scopes, and nothing is cached
+    //until Exec, so this doesn't need locks
     class Scope
     {
+        friend class NormalScope;
+        friend class ImportScope;
+
+        //scopes that look things up through this one
+        std::vector<Scope*> dependents;
+
+        unsigned int generation; //never 0
+        //something visible from here may have been cached since generation last changed.
+        //if a scope is watched, so is everything it looks things up through
+        bool watched;
+
+        static std::atomic<unsigned int> clock; //where generations come from
+
+        void addDependent(Scope* s) {dependents.push_back(s);}
+        void removeDependent(Scope* s);
+
+        //s, which this scope looks things up through, is going away
+        virtual void forget(Scope* s) = 0;
+        //mark this and everything it looks things up through as watched
+        virtual void watch() = 0;
+
     public:
+        Scope();
+        virtual ~Scope();
+
         virtual DeclExpr* getVarDef(Ident name) = 0;
-        virtual std::vector<DeclExpr*> getVarDefs(Ident name) = 0;
+        //append all defs of name visible from here to out, outermost first
+        virtual void collectVarDefs(Ident name, std::vector<DeclExpr*>& out) = 0;
         virtual TypeDef * getTypeDef(Ident name) = 0;
 
         //virtual bool canSee(Scope* other) = 0;
 
-        virtual ~Scope() {};
+        //the generation to cache lookups made from here with
+        unsigned int cacheGeneration() {watch(); return generation;}
+        //something visible from here changed, so drop what's cached here and in every
+        //scope that looks through this one
+        void invalidate();
+
+        //bumped whenever an import cycle cuts a lookup short, because the result of that
+        //lookup depends on where it started and can't be cached
+        static std::atomic<unsigned int> cycleCuts;
     };
 
     class NormalScope : public Scope
     {
         Scope *parent;
 
+        //not copyable, scopes know who looks through them
+        NormalScope(const NormalScope&);
+        NormalScope& operator=(const NormalScope&);
+
+        void forget(Scope* s);
+        void watch();
+
     public: //maybe find a better way?
 
         std::map<Ident, TypeDef> typeDefs;
         std::vector<DeclExpr*> varDefs;
 
+    private:
+        //name -> defs in this scope with that name, in order of declaration
+        std::unordered_map<Ident, std::vector<DeclExpr*>> index;
+
+        struct CacheEntry
+        {
+            unsigned int generation;
+            std::vector<DeclExpr*> defs;
+        };
+        //name -> result of getVarDefs
+        std::unordered_map<Ident, CacheEntry> lookupCache;
+
+    public:
         //insert var def into current scope
         void addVarDef(DeclExpr* decl);
         void removeVarDef(DeclExpr* decl);
+        //replace all of the var defs at once, keeping their order. for the module cache
+        void resetVarDefs(const std::vector<DeclExpr*>& defs);
         //recursively find def in all scope parents
         DeclExpr* getVarDef(Ident name);
-        std::vector<DeclExpr*> getVarDefs(Ident name);
+        void collectVarDefs(Ident name, std::vector<DeclExpr*>& out);
+        //all defs of name visible from here, outermost first. this is cached, so the
+        //reference is only good until the next scope is modified
+        const std::vector<DeclExpr*>& getVarDefs(Ident name);
 
         NormalScope() : parent(0) {};
-        NormalScope(Scope *p) : parent(p) {};
+        NormalScope(Scope *p);
+        ~NormalScope();
 
         //likewise
         void addTypeDef(Ident name, TypeDef & td);
@@ -60,24 +127,21 @@ namespace ast
         std::list<Scope*> imports;
         bool hasVisited; //to stop cycles
 
-    public:
-        ImportScope(Scope *p) : hasVisited(false)
-        {
-            imports.push_back(p);
-        }
+        ImportScope(const ImportScope&);
+        ImportScope& operator=(const ImportScope&);
 
-        void Import(Scope* other)
-        {
-            imports.push_back(other);
-        }
+        void forget(Scope* s);
+        void watch();
 
-        void UnImport(Scope* other)
-        {
-            imports.remove(other);
-        }
+    public:
+        ImportScope(Scope *p);
+        ~ImportScope();
+
+        void Import(Scope* other);
+        void UnImport(Scope* other);
 
         DeclExpr* getVarDef(Ident name);
-        std::vector<DeclExpr*> getVarDefs(Ident name);
+        void collectVarDefs(Ident name, std::vector<DeclExpr*>& out);
         TypeDef * getTypeDef(Ident name);
 
         bool canSee(Scope* other);
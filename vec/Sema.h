@@ -6,6 +6,7 @@
 #include "AstWalker.h"
 
 #include <functional>
+#include <ostream>
 
 namespace sa
 {
@@ -21,7 +22,15 @@ namespace sa
         //add/rearrange nodes in AST
         void Phase1();
 
+        //the passes that make up phase 1, in order
+        void lowerLocal(); //everything that only changes a node and its children
+        void buildBlocks(); //merge rho stmts into basic blocks
+        void cleanup();
+
         void Import();
+
+        //time spent in each phase 1 pass, for --stats
+        static void printStats(std::ostream& os);
     };
 }
 
@@ -5,6 +5,9 @@
 
 #include <cassert>
 #include <set>
+#include <chrono>
+#include <iomanip>
+#include <mutex>
 
 using namespace ast;
 using namespace sa;
@@ -26,8 +29,9 @@ void ifyFlatten (NodeN* ify)
         comma = ify->detachChildAs<OverloadCallExpr>(ify->Children().size() - 1);
     }
 
-    //replace the non-comma
-    ify->setChild(ify->Children().size() - 1, move(comma));
+    //replace the non-comma. if the last element isn't a call at all it was never detached
+    if (comma)
+        ify->setChild(ify->Children().size() - 1, move(comma));
 }
 
 bool isValIgnored(Node0* val)
@@ -45,79 +49,269 @@ bool isValIgnored(Node0* val)
     return false;
 }
 
-void Sema::Phase1()
+namespace
 {
-    //TODO: insert ScopeEntryExpr and ScopeExitExpr or somesuch
-
-    for (auto opAs : Subtree<OpAssignExpr>(mod).cached())
+    //walk the tree in postorder, letting the visitor replace nodes as it goes. unlike Subtree
+    //this is safe as long as a node only replaces itself or its own children, and only from
+    //leave(). enter() is called in preorder and may rearrange the node's children.
+    template<class Visitor>
+    void rewriteWalk(Node0* root, Visitor& v)
     {
-        // a += b
-        // becomes
-        // tmp = leval(a)
-        // *tmp = *tmp + eval(b)
-
-        tok::Token op;
-        op.type = opAs->assignOp;
-        op.loc = opAs->opLoc;
-
-        Ptr tmp = Ptr(new TmpExpr(opAs->getChildA())); //first temp
-        Ptr call = Ptr(new OverloadCallExpr(op, opAs->sco, move(tmp), opAs->detachChildB()));
-
-        tmp = Ptr(new TmpExpr(opAs->getChildA())); //second temp
-        Ptr asgn = Ptr(new AssignExpr(move(tmp), move(call), op.loc));
-        Ptr seq = Ptr(new StmtPair(opAs->detachChildA(), move(asgn)));
-        opAs->parent->replaceChild(opAs, move(seq));
-    }
+        struct Frame
+        {
+            Node0* n;
+            Node0* next; //next child to visit
+        };
 
-    for (auto ify : Subtree<ListifyExpr>(mod))
-        ifyFlatten(ify);
-    for (auto ify : Subtree<TuplifyExpr>(mod))
-        ifyFlatten(ify);
+        std::vector<Frame> stack;
+        v.enter(root);
+        Frame rf = {root, root->childAfter(nullptr)};
+        stack.push_back(rf);
 
-    //now throw away any other commas
-    for (auto comma : Subtree<OverloadCallExpr>(mod).cached())
-    {
-        if (comma->fun->Op() != tok::comma)
-            continue;
-        Ptr pair = Ptr(new StmtPair(comma->detachChild(0), comma->detachChild(1)));
-        comma->parent->replaceChild(comma, move(pair));
+        while (!stack.empty())
+        {
+            Frame& top = stack.back();
+            if (top.next)
+            {
+                Node0* child = top.next;
+                //find the sibling now, since child may not be here after we're done with it
+                top.next = top.n->childAfter(child);
+                v.enter(child);
+                Frame f = {child, child->childAfter(nullptr)};
+                stack.push_back(f); //invalidates top
+            }
+            else
+            {
+                Node0* n = top.n;
+                stack.pop_back();
+                v.leave(n);
+            }
+        }
     }
 
-    //push flattened tuplify exprs into func calls
-    for (auto call : Subtree<OverloadCallExpr>(mod))
+    //all of the rewrites that only look at a node and its children, done in one walk.
+    //they're applied in the same order they would be if each was a walk of its own
+    struct LocalLowering
     {
-        auto args = call->detachChildAs<TuplifyExpr>(0);
-        if (!args)
-            continue;
-        call->popChild();
-        call->swap(args.get());
-    }
+        //IterExprs that haven't found their ExprStmt yet, and where each enclosing ExprStmt's
+        //start in that list
+        std::vector<IterExpr*> iters;
+        std::vector<size_t> exprStmtStarts;
+        //same for AggExprs, which take the IterExprs under them for themselves
+        std::vector<size_t> aggStarts;
+
+        void enter(Node0* n)
+        {
+            switch (n->Kind())
+            {
+            case NodeKind::ListifyExpr:
+            case NodeKind::TuplifyExpr:
+                //do this before the commas under it are visited so they aren't thrown away
+                ifyFlatten(static_cast<NodeN*>(n));
+                break;
+            case NodeKind::ExprStmt:
+                exprStmtStarts.push_back(iters.size());
+                break;
+            case NodeKind::AggExpr:
+                aggStarts.push_back(iters.size());
+                break;
+            default:
+                break;
+            }
+        }
 
-    int intrin_num = 0; //because of the way this works, all intrins need to be in one file
+        void leave(Node0* n)
+        {
+            switch (n->Kind())
+            {
+            case NodeKind::OpAssignExpr: opAssign(static_cast<OpAssignExpr*>(n)); break;
+            case NodeKind::OverloadCallExpr: call(static_cast<OverloadCallExpr*>(n)); break;
+            case NodeKind::AssignExpr: assign(static_cast<AssignExpr*>(n)); break;
+            case NodeKind::IterExpr: iters.push_back(static_cast<IterExpr*>(n)); break;
+            case NodeKind::AggExpr: aggExpr(static_cast<AggExpr*>(n)); break;
+            case NodeKind::ExprStmt: exprStmt(static_cast<ExprStmt*>(n)); break;
+            case NodeKind::Block: block(static_cast<Block*>(n)); break;
+            case NodeKind::IfStmt: ifStmt(static_cast<IfStmt*>(n)); break;
+            case NodeKind::IfElseStmt: ifElseStmt(static_cast<IfElseStmt*>(n)); break;
+            default: break;
+            }
+        }
 
-    for (auto ae : Subtree<AssignExpr>(mod).cached())
-    {
-        DeclExpr* fde = exact_cast<DeclExpr*>(ae->getChildA());
-        //TODO: or varexpr?
-        if (!fde)
-            continue;
+        void opAssign(OpAssignExpr* opAs)
+        {
+            // a += b
+            // becomes
+            // tmp = leval(a)
+            // *tmp = *tmp + eval(b)
+
+            tok::Token op;
+            op.type = opAs->assignOp;
+            op.loc = opAs->opLoc;
+
+            Ptr tmp = Ptr(new TmpExpr(opAs->getChildA())); //first temp
+            auto call = MkNPtr(new OverloadCallExpr(op, opAs->sco, move(tmp), opAs->detachChildB()));
+            OverloadCallExpr* callp = call.get();
+
+            tmp = Ptr(new TmpExpr(opAs->getChildA())); //second temp
+            Ptr asgn = Ptr(new AssignExpr(move(tmp), move(call), op.loc));
+            Ptr seq = Ptr(new StmtPair(opAs->detachChildA(), move(asgn)));
+            opAs->parent->replaceChild(opAs, move(seq));
+
+            //the call is new, so the walk won't see it. a &&= b needs to be short circuited
+            this->call(callp);
+        }
 
-        //insert intrinsic declaration if that's what this is
-        if (VarExpr* ve = exact_cast<VarExpr*>(ae->getChildB()))
+        void call(OverloadCallExpr* call)
         {
-            if (ve->Name() == Global().reserved.intrin)
+            //throw away commas that weren't flattened into a listify or tuplify
+            if (call->fun->Op() == tok::comma)
             {
-                //defining the same intrinsic twice causes a crash on this line
-                //not a huge deal, but not ideal
-                auto ide = MkNPtr(new IntrinDeclExpr(fde, intrin_num));
-                ++intrin_num;
+                Ptr pair = Ptr(new StmtPair(call->detachChild(0), call->detachChild(1)));
+                call->parent->replaceChild(call, move(pair));
+                return;
+            }
 
-                ae->parent->replaceChild(ae, move(ide));
-                continue;
+            //push flattened tuplify exprs into func calls
+            auto args = call->detachChildAs<TuplifyExpr>(0);
+            if (args)
+            {
+                call->popChild();
+                call->swap(args.get());
             }
+
+            if (call->fun->Op() == tok::barbar || call->fun->Op() == tok::ampamp)
+                shortCircuit(call);
+        }
+
+        void shortCircuit(OverloadCallExpr* scOp)
+        {
+            auto rho = MkNPtr(new RhoStmt());
+            auto controlled2 = MkNPtr(new BranchStmt(scOp->detachChild(1)));
+            auto controlled1 = MkNPtr(new BranchStmt(scOp->detachChild(0),
+                //for and, we eval the rhs if the lhs is true
+            /*ifTrue  = */ scOp->fun->Op() == tok::ampamp ? controlled2.get() : nullptr,
+                //for or, we eval the rhs if the lhs is false
+            /*ifFalse = */ scOp->fun->Op() == tok::barbar ? controlled2.get() : nullptr
+                ));
+
+            auto phi = MkNPtr(new PhiExpr(scOp->loc));
+            phi->inputs.push_back(controlled1.get());
+            phi->inputs.push_back(controlled2.get());
+
+            rho->appendChild(move(controlled1));
+            rho->appendChild(move(controlled2));
+
+            scOp->parent->replaceChild(scOp, Ptr(new StmtPair(move(rho), move(phi))));
+        }
+
+        void assign(AssignExpr* ae)
+        {
+            DeclExpr* fde = exact_cast<DeclExpr*>(ae->getChildA());
+            //TODO: or varexpr?
+            if (!fde)
+                return;
+
+            //TODO: insert lambda when function is defined "pointfree"
+        }
+
+        //add loop points for ` expr, and eliminate the ExprStmt
+        //+=`a adds up a, so the ` belongs to it and not the statement
+        void aggExpr(AggExpr* agg)
+        {
+            size_t start = aggStarts.back();
+            aggStarts.pop_back();
+
+            agg->targets.assign(iters.begin() + start, iters.end());
+            iters.resize(start);
+        }
+
+        //FIXME: putting ` in an if condition probably has unexpected results
+        void exprStmt(ExprStmt* es)
+        {
+            size_t start = exprStmtStarts.back();
+            exprStmtStarts.pop_back();
+
+            Ptr conts = es->detachChildA();
+            if (start != iters.size())
+            {
+                auto il = MkNPtr(new ImpliedLoopStmt(move(conts)));
+                il->targets.assign(iters.begin() + start, iters.end());
+                iters.resize(start);
+                conts = move(il);
+            }
+            es->parent->replaceChild(es, move(conts));
+        }
+
+        void block(Block* b)
+        {
+            b->parent->replaceChild(b, b->detachChildA());
+        }
+
+        //convert control statements into their branch forms
+
+        void ifStmt(IfStmt* If)
+        {
+            auto rho = MkNPtr(new RhoStmt());
+        
+            auto controlled = MkNPtr(new BranchStmt(If->detachChildB()));
+
+            Ptr condPtr = If->detachChildA();
+            rho->appendChild(Ptr(new BranchStmt(move(condPtr), controlled.get(), nullptr)));
+            rho->appendChild(move(controlled));
+            If->parent->replaceChild(If, move(rho));
         }
-        //TODO: insert lambda when function is defined "pointfree"
-    }
+
+        void ifElseStmt(IfElseStmt* IfElse)
+        {
+            auto rho = MkNPtr(new RhoStmt());
+        
+            auto controlled1 = MkNPtr(new BranchStmt(IfElse->detachChildB()));
+            auto controlled2 = MkNPtr(new BranchStmt(IfElse->detachChildC()));
+
+            Ptr condPtr = IfElse->detachChildA();
+            rho->appendChild(Ptr(new BranchStmt(move(condPtr), controlled1.get(), controlled2.get())));
+            rho->appendChild(move(controlled1));
+            rho->appendChild(move(controlled2));
+            IfElse->parent->replaceChild(IfElse, move(rho));
+        }
+        //TODO: the rest of them
+    };
+
+    //things to tidy up once the basic blocks are built
+    struct Cleanup
+    {
+        void enter(Node0*) {}
+
+        void leave(Node0* n)
+        {
+            //now any Branch stmts that branch to null must leave the function
+            if (BranchStmt* br = exact_cast<BranchStmt*>(n))
+            {
+                if (!br->ifTrue)
+                    br->setChildA(Ptr(new ReturnStmt(br->detachChildA())));
+            }
+            //remove null stmts under StmtPairs
+            else if (StmtPair* sp = exact_cast<StmtPair*>(n))
+            {
+                if (exact_cast<NullStmt*>(sp->getChildA()) != 0
+                 || exact_cast<NullExpr*>(sp->getChildA()) != 0)
+                    sp->parent->replaceChild(sp, sp->detachChildB());
+                /* //this changes the semantics!
+                else if (exact_cast<NullStmt*>(sp->getChildB()) != 0
+                      || exact_cast<NullExpr*>(sp->getChildB()) != 0)
+                    sp->parent->replaceChild(sp, sp->detachChildA());*/
+            }
+        }
+    };
+}
+
+void Sema::lowerLocal()
+{
+    //TODO: insert ScopeEntryExpr and ScopeExitExpr or somesuch
+
+    LocalLowering ll;
+    rewriteWalk(mod, ll);
+    assert(ll.iters.empty() && "ExprStmt not found");
 
     //do this after types in case of ref types
 /*
@@ -137,36 +331,6 @@ void Sema::Phase1()
                 << ex->getChild<1>()->loc << err::underline << err::endl;
     });
 */
-    //add loop points for ` expr
-    //TODO: detect agg exprs
-    //FIXME: putting ` in an if condition probably has unexpected results
-    for (auto ie : Subtree<IterExpr>(mod))
-    {
-        //find nearest exprStmt up the tree
-        Node0* n;
-        for (n = ie; exact_cast<ExprStmt*>(n) == 0; n = n->parent)
-            assert(n != 0 && "ExprStmt not found");
-
-        ExprStmt* es = exact_cast<ExprStmt*>(n);
-        ImpliedLoopStmt* il = exact_cast<ImpliedLoopStmt*>(es->parent);
-        
-        if (!il)
-        {
-            Node0* esParent = es->parent; //save because the c'tor clobbers it
-            il = new ImpliedLoopStmt(es->detachSelf());
-            esParent->replaceDetachedChild(Ptr(il));
-        }
-        
-        il->targets.push_back(ie);
-    }
-
-    //eliminate blocks and ExprStmts
-    //this needs to happen after loop point addition so (x;) works
-    for (auto es : Subtree<ExprStmt>(mod).cached())
-            es->parent->replaceChild(es, es->detachChildA());
-
-    for (auto b : Subtree<Block>(mod).cached())
-            b->parent->replaceChild(b, b->detachChildA());
 
     //replace variables that represent overloaded functions with the function that they
     //must represent, if there is only one such function
@@ -184,60 +348,10 @@ void Sema::Phase1()
             ve->var = oGroup->functions.front();
     }
     */
+}
 
-    //convert control statements into their branch forms
-
-    for (auto If : Subtree<IfStmt>(mod).cached())
-    {
-        auto rho = MkNPtr(new RhoStmt());
-        
-        auto controlled = MkNPtr(new BranchStmt(If->detachChildB()));
-
-        Ptr condPtr = If->detachChildA();
-        rho->appendChild(Ptr(new BranchStmt(move(condPtr), controlled.get(), nullptr)));
-        rho->appendChild(move(controlled));
-        If->parent->replaceChild(If, move(rho));
-    }
-
-    for (auto IfElse : Subtree<IfElseStmt>(mod).cached())
-    {
-        auto rho = MkNPtr(new RhoStmt());
-        
-        auto controlled1 = MkNPtr(new BranchStmt(IfElse->detachChildB()));
-        auto controlled2 = MkNPtr(new BranchStmt(IfElse->detachChildC()));
-
-        Ptr condPtr = IfElse->detachChildA();
-        rho->appendChild(Ptr(new BranchStmt(move(condPtr), controlled1.get(), controlled2.get())));
-        rho->appendChild(move(controlled1));
-        rho->appendChild(move(controlled2));
-        IfElse->parent->replaceChild(IfElse, move(rho));
-    }
-
-    for (auto scOp : Subtree<OverloadCallExpr>(mod).cached())
-    {
-        if (scOp->fun->Op() != tok::barbar && scOp->fun->Op() != tok::ampamp)
-            continue;
-        
-        auto rho = MkNPtr(new RhoStmt());
-        auto controlled2 = MkNPtr(new BranchStmt(scOp->detachChild(1)));
-        auto controlled1 = MkNPtr(new BranchStmt(scOp->detachChild(0),
-            //for and, we eval the rhs if the lhs is true
-        /*ifTrue  = */ scOp->fun->Op() == tok::ampamp ? controlled2.get() : nullptr,
-            //for or, we eval the rhs if the lhs is false
-        /*ifFalse = */ scOp->fun->Op() == tok::barbar ? controlled2.get() : nullptr
-            ));
-
-        auto phi = MkNPtr(new PhiExpr(scOp->loc));
-        phi->inputs.push_back(controlled1.get());
-        phi->inputs.push_back(controlled2.get());
-
-        rho->appendChild(move(controlled1));
-        rho->appendChild(move(controlled2));
-
-        scOp->parent->replaceChild(scOp, Ptr(new StmtPair(move(rho), move(phi))));
-    }
-    //TODO: the rest of them
-
+void Sema::buildBlocks()
+{
     //merge all rho stmts into one, underneath the function def (or compilation unit)
     auto globalRho = MkNPtr(new RhoStmt());
     globalRho->appendChild(Ptr(new BranchStmt(mod->detachChildA())));
@@ -360,26 +474,46 @@ void Sema::Phase1()
         oldOwner->clear();
         oldOwner->consume(move(newOwner));
     }
+}
 
-    //now any Branch stmts that branch to null must leave the function
-    for (auto br : Subtree<BranchStmt>(mod))
+void Sema::cleanup()
+{
+    Cleanup c;
+    rewriteWalk(mod, c);
+}
+
+namespace
+{
+    typedef std::chrono::high_resolution_clock Clock;
+
+    struct Phase1Pass
     {
-        if (br->ifTrue)
-            continue;
+        const char* name;
+        void (Sema::*run)();
+        Clock::duration time; //total over all modules
+    };
 
-        br->setChildA(Ptr(new ReturnStmt(br->detachChildA())));
-    }
+    Phase1Pass phase1Passes[] =
+    {
+        {"lower", &Sema::lowerLocal, Clock::duration::zero()},
+        {"basic blocks", &Sema::buildBlocks, Clock::duration::zero()},
+        {"cleanup", &Sema::cleanup, Clock::duration::zero()},
+    };
 
-    //remove null stmts under StmtPairs
-    for (auto sp : Subtree<StmtPair>(mod).cached())
+    //modules can go through phase 1 at the same time
+    std::mutex phase1TimeMutex;
+}
+
+void Sema::Phase1()
+{
+    for (auto& pass : phase1Passes)
     {
-        if (exact_cast<NullStmt*>(sp->getChildA()) != 0
-         || exact_cast<NullExpr*>(sp->getChildA()) != 0)
-            sp->parent->replaceChild(sp, sp->detachChildB());
-        /* //this changes the semantics!
-        else if (exact_cast<NullStmt*>(sp->getChildB()) != 0
-              || exact_cast<NullExpr*>(sp->getChildB()) != 0)
-            sp->parent->replaceChild(sp, sp->detachChildA());*/
+        Clock::time_point start = Clock::now();
+        (this->*pass.run)();
+        Clock::duration time = Clock::now() - start;
+
+        std::lock_guard<std::mutex> lock(phase1TimeMutex);
+        pass.time += time;
     }
 
     //TODO: it might be worthwhile, after each stage of sema to validate the tree and check for
@@ -387,3 +521,12 @@ void Sema::Phase1()
     //bail out. or we could check each time the iterator goes through. that might actually be a
     //valid use case for exceptions...
 }
+
+void Sema::printStats(std::ostream& os)
+{
+    os << "phase 1:\n";
+    for (auto& pass : phase1Passes)
+        os << "  " << std::left << std::setw(14) << pass.name << std::right
+            << std::chrono::duration_cast<std::chrono::microseconds>(pass.time).count()
+            << " us\n";
+}
@@ -11,11 +11,8 @@ using namespace sa;
 
 void Sema::Import()
 {
-    //eventually, import all modules mentioned in the current one
-    Module* intrinsic = Global().findModule("intrinsic");
-
-    if (mod != intrinsic)
-        mod->PublicImport(intrinsic);
+    //eventually, import all modules mentioned in the current one. the intrinsics are
+    //in the universal scope, so they don't need importing
 
     //things to be fixed up are decl exprs that point to external types. we look
     //in private because that's the highest global scope, and the highest one that
@@ -10,6 +10,9 @@ namespace ast
     //This file is for AST nodes that are added during semantic analysis, rather than parsing
     struct TmpExpr : public Node0
     {
+        static const NodeKind kind = NodeKind::TmpExpr;
+        NodeKind myKind() {return kind;}
+
         const char *myColor() {return "8";};
         std::string myLbl () {return "tmp";};
         Node0* setBy;
@@ -32,6 +35,9 @@ namespace ast
     //a "routing" node that contains BranchStmts
     struct RhoStmt : public NodeN
     {
+        static const NodeKind kind = NodeKind::RhoStmt;
+        NodeKind myKind() {return kind;}
+
         std::string myLbl() {return "rho";}
         const char *myColor() {return "3";}
         void preExec(sa::Exec&);
@@ -41,6 +47,9 @@ namespace ast
     //a BranchStmt is the terminator of the basic block that is attached below it
     struct BranchStmt : public Node1
     {
+        static const NodeKind kind = NodeKind::BranchStmt;
+        NodeKind myKind() {return kind;}
+
         //either of these being null means "leave the current rho block"
         BranchStmt* ifTrue;
         BranchStmt* ifFalse;
@@ -82,6 +91,9 @@ namespace ast
     //Generalization of TmpExpr for any number of predecessor blocks
     struct PhiExpr : public Node0
     {
+        static const NodeKind kind = NodeKind::PhiExpr;
+        NodeKind myKind() {return kind;}
+
         std::vector<BranchStmt*> inputs;
 
         const char *myColor() {return "8";};
@@ -103,11 +115,17 @@ namespace ast
 
     struct ImpliedLoopStmt : public Node1
     {
+        static const NodeKind kind = NodeKind::ImpliedLoopStmt;
+        NodeKind myKind() {return kind;}
+
         std::vector<IterExpr*> targets;
+        bool parallel; //the elements are independent, so it can run on the thread pool
         ImpliedLoopStmt(Ptr arg)
-            : Node1(move(arg))
+            : Node1(move(arg)), parallel(false)
         {};
         std::string myLbl() {return "for (`)";}
+        void preExec(sa::Exec&);
+        llvm::Value* generate(cg::CodeGen& gen);
 
         void emitDot(std::ostream& os)
         {
@@ -121,15 +139,24 @@ namespace ast
     //TODO: do it this way, or with inline assembly?
     struct IntrinDeclExpr : public DeclExpr
     {
+        static const NodeKind kind = NodeKind::IntrinDeclExpr;
+        NodeKind myKind() {return kind;}
+
         int intrin_id;
         //it's "based on" func so it's ok not to use Ptr
         IntrinDeclExpr(DeclExpr* func, int id)
             : DeclExpr(*func), intrin_id(id) {}
+        //built in, so it's from nowhere
+        IntrinDeclExpr(Ident n, NormalScope* s, typ::Type t, int id)
+            : DeclExpr(n, s, t, tok::Location()), intrin_id(id) {}
         const char *myColor() {return "8";};
     };
 
     struct IntrinCallExpr : public NodeN
     {
+        static const NodeKind kind = NodeKind::IntrinCallExpr;
+        NodeKind myKind() {return kind;}
+
         int intrin_id;
         IntrinCallExpr(NPtr<OverloadCallExpr>::type orig, int intrin_id)
             : NodeN(orig->loc),
@@ -143,10 +170,16 @@ namespace ast
         const char *myColor() {return "5";}
         void preExec(sa::Exec&);
         llvm::Value* generate(cg::CodeGen& gen);
+
+        //for x = x $ y, the variable x. the result can be built in x's own storage
+        VarExpr* appendTarget();
     };
 
     struct ArithCast : public Node1
     {
+        static const NodeKind kind = NodeKind::ArithCast;
+        NodeKind myKind() {return kind;}
+
         ArithCast(typ::Type to, Ptr node)
             : Node1(move(node)) {Annotate(to);}
         std::string myLbl() {return "(" + Type().to_str() + ")";}
@@ -0,0 +1,156 @@
+#include "SourceManager.h"
+#include "Error.h"
+
+#include <fstream>
+#include <cstring>
+#include <algorithm>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace tok;
+
+//fallback buffers are padded to this so they look like a mapping would
+#define PAGE_SIZE_FALLBACK 4096
+
+SourceBuffer::~SourceBuffer()
+{
+#ifndef _WIN32
+    if (mapping)
+        munmap(mapping, mapLen);
+#endif
+}
+
+//mmap zero fills the rest of the last page, so we get the nul for free unless the file
+//ends right on a page boundary (or is empty, which mmap won't do)
+bool SourceManager::mapFile(SourceBuffer& buf, const char* path)
+{
+#ifdef _WIN32
+    (void)buf; (void)path;
+    return false;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)
+        || st.st_size == 0 || (size_t)st.st_size % pageSize == 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    size_t size = (size_t)st.st_size;
+    void* mem = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); //the mapping keeps the file open
+    if (mem == MAP_FAILED)
+        return false;
+
+    buf.mapping = mem;
+    buf.mapLen = size;
+    buf.b = static_cast<const char*>(mem);
+    buf.len = size;
+    return true;
+#endif
+}
+
+bool SourceManager::readFile(SourceBuffer& buf, const char* path)
+{
+    std::ifstream t(path, std::ios_base::in | std::ios_base::binary); //to keep CR / CRLF from messing us up
+    if (!t.is_open())
+        return false;
+
+    t.seekg(0, std::ios::end);
+    size_t size = (size_t)t.tellg();
+    t.seekg(0);
+
+    //room for at least one nul, rounded up to a whole page
+    size_t padded = (size / PAGE_SIZE_FALLBACK + 1) * PAGE_SIZE_FALLBACK;
+    buf.owned.reset(new char[padded]);
+    t.read(buf.owned.get(), size);
+    memset(buf.owned.get() + size, 0, padded - size);
+
+    buf.b = buf.owned.get();
+    buf.len = size;
+    return true;
+}
+
+const SourceBuffer* SourceManager::load(const std::string& path)
+{
+    std::unique_ptr<SourceBuffer> buf(new SourceBuffer());
+    if (!mapFile(*buf, path.c_str()) && !readFile(*buf, path.c_str()))
+        return nullptr;
+
+    buf->fileName = path.substr(path.find_last_of("/\\") + 1);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (buf->len < UINT32_MAX - nextStart)
+        {
+            buf->start = nextStart;
+            nextStart += uint32_t(buf->len) + 1;
+
+            buffers.push_back(std::move(buf));
+            return buffers.back().get();
+        }
+    }
+
+    //not while holding the lock, printing it needs expand
+    err::Error(err::fatal, Location()) << "source files are too big, over 4GB total";
+    throw err::FatalError();
+}
+
+SourceBuffer* SourceManager::bufferFor(uint32_t offset)
+{
+    //find the last buffer starting at or before offset
+    auto it = std::upper_bound(buffers.begin(), buffers.end(), offset,
+        [] (uint32_t off, const std::unique_ptr<SourceBuffer>& buf) {return off < buf->start;});
+    if (it == buffers.begin())
+        return nullptr;
+    return (--it)->get();
+}
+
+FullLocation SourceManager::expand(Location loc)
+{
+    FullLocation ret;
+    std::lock_guard<std::mutex> lock(mutex);
+    SourceBuffer* buf = loc.begin ? bufferFor(loc.begin) : nullptr;
+    if (!buf)
+        return ret;
+
+    if (buf->lineStarts.empty())
+    {
+        buf->lineStarts.push_back(0);
+        for (size_t i = 0; i < buf->len; ++i)
+            if (buf->b[i] == '\n')
+                buf->lineStarts.push_back(uint32_t(i + 1));
+    }
+
+    uint32_t off = loc.begin - buf->start;
+    auto lineIt = std::upper_bound(buf->lineStarts.begin(), buf->lineStarts.end(), off) - 1;
+
+    ret.fileName = buf->fileName.c_str();
+    ret.line = int(lineIt - buf->lineStarts.begin()) + 1;
+    ret.lineStr.assign(buf->b + *lineIt);
+
+    //work out the columns, counting tabs as TAB_SIZE
+    uint32_t last = loc.end > loc.begin ? loc.end - 1 - buf->start : off;
+    const char* p = ret.lineStr.begin();
+    int col = 0;
+    for (; p < ret.lineStr.end() && p < buf->b + off; ++p)
+        col += *p == '\t' ? TAB_SIZE : 1;
+    ret.firstCol = col;
+
+    //if it goes onto the next line, stop at the end of this one
+    for (; p + 1 < ret.lineStr.end() && p < buf->b + last; ++p)
+        col += *p == '\t' ? TAB_SIZE : 1;
+    ret.lastCol = col;
+
+    return ret;
+}
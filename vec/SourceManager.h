@@ -0,0 +1,98 @@
+#ifndef SOURCEMANAGER_H
+#define SOURCEMANAGER_H
+
+#include "Location.h"
+
+#include <string>
+#include <ostream>
+#include <vector>
+#include <memory>
+#include <mutex>
+
+namespace tok
+{
+    //the contents of a source file. always followed by a nul, which the lexer relies on
+    class SourceBuffer
+    {
+        friend class SourceManager;
+
+        const char* b;
+        size_t len;
+
+        //exactly one of these is set
+        void* mapping; //from mmap. munmap mapLen bytes of it when done
+        size_t mapLen;
+        std::unique_ptr<char[]> owned; //read in the usual way
+
+        std::string fileName; //without the directory
+        uint32_t start; //location of the first character
+
+        //offset of the start of each line. filled in the first time someone asks
+        std::vector<uint32_t> lineStarts;
+
+        SourceBuffer() : b(nullptr), len(0), mapping(nullptr), mapLen(0), start(0) {}
+
+    public:
+        ~SourceBuffer();
+
+        const char* begin() const {return b;}
+        const char* end() const {return b + len;} //points at the nul
+        size_t size() const {return len;}
+
+        const std::string& name() const {return fileName;}
+
+        //location of the character at p, which must be in [begin(), end()]
+        Location locationOf(const char* p) const
+        {
+            uint32_t off = start + uint32_t(p - b);
+            return Location(off, off + 1);
+        }
+    };
+
+    //a Location in terms people understand
+    struct FullLocation
+    {
+        const char* fileName; //nul terminated
+        int line; //1 based
+        int firstCol, lastCol; //0 based, tabs count for TAB_SIZE. inclusive
+        utl::weak_string lineStr; //the whole first line
+
+        FullLocation() : fileName(""), line(0), firstCol(0), lastCol(0) {}
+    };
+
+    template <class CharT, class Traits>
+    inline std::basic_ostream<CharT, Traits>& 
+        operator<< (std::basic_ostream<CharT, Traits>& os, const FullLocation& loc)
+    {
+        os << loc.fileName << ':' << loc.line << ':' << loc.firstCol;
+        return os;
+    }
+
+    //owns the contents of every source file, so tokens and locations can point straight
+    //into them. files are mapped into memory when possible instead of being read.
+    //each file gets a range of locations (plus one for the nul, so eof has a location).
+    //it can be used from any thread
+    class SourceManager
+    {
+        std::mutex mutex; //for buffers, nextStart, and the buffers' lineStarts
+        std::vector<std::unique_ptr<SourceBuffer>> buffers; //ordered by start
+        uint32_t nextStart;
+
+        static bool mapFile(SourceBuffer& buf, const char* path);
+        static bool readFile(SourceBuffer& buf, const char* path);
+
+        SourceBuffer* bufferFor(uint32_t offset);
+
+    public:
+        SourceManager() : nextStart(1) {} //0 is nowhere
+
+        //returns null if the file can't be opened
+        const SourceBuffer* load(const std::string& path);
+
+        //this is slow-ish the first time it's called for each file, but it's only needed
+        //for printing errors
+        FullLocation expand(Location loc);
+    };
+}
+
+#endif
@@ -10,6 +10,9 @@ namespace ast
     //TODO: do I even need this, given that nullExpr exists?
     struct NullStmt : public Node0
     {
+        static const NodeKind kind = NodeKind::NullStmt;
+        NodeKind myKind() {return kind;}
+
         NullStmt(tok::Location const &l) : Node0(l) {};
         std::string myLbl() {return "Null";}
         const char *myColor() {return "9";}
@@ -18,6 +21,9 @@ namespace ast
 
     struct ExprStmt : public Node1
     {
+        static const NodeKind kind = NodeKind::ExprStmt;
+        NodeKind myKind() {return kind;}
+
         ExprStmt(Ptr conts)
             : Node1(move(conts))
         {};
@@ -27,7 +33,11 @@ namespace ast
 
     struct StmtPair : public Node2
     {
-        StmtPair(Ptr lhs, Ptr rhs) : Node2(move(lhs), move(rhs)) {};
+        static const NodeKind kind = NodeKind::StmtPair;
+        NodeKind myKind() {return kind;}
+
+        //its value is rhs's, so errors about that value point at rhs
+        StmtPair(Ptr lhs, Ptr rhs) : Node2(move(lhs), move(rhs)) {loc = getChildB()->loc;};
         std::string myLbl() {return ";";}
         const char *myColor() {return "3";}
         void emitDot(std::ostream &os)
@@ -46,6 +56,9 @@ namespace ast
 
     struct Block : public Node1
     {
+        static const NodeKind kind = NodeKind::Block;
+        NodeKind myKind() {return kind;}
+
         //needed for scope entry&exit points
         NormalScope *scope;
         Block(Ptr conts, NormalScope *s, tok::Location const &l)
@@ -58,6 +71,9 @@ namespace ast
 
     struct IfStmt : public Node2
     {
+        static const NodeKind kind = NodeKind::IfStmt;
+        NodeKind myKind() {return kind;}
+
         IfStmt(Ptr pred, Ptr act, tok::Token &o)
             : Node2(move(pred), move(act))
         {
@@ -68,6 +84,9 @@ namespace ast
 
     struct IfElseStmt : public Node3
     {
+        static const NodeKind kind = NodeKind::IfElseStmt;
+        NodeKind myKind() {return kind;}
+
         IfElseStmt(Ptr pred, Ptr act1, Ptr act2, tok::Token &o)
             : Node3(move(pred), move(act1), move(act2))
         {
@@ -78,6 +97,9 @@ namespace ast
 
     struct SwitchStmt : public Node2
     {
+        static const NodeKind kind = NodeKind::SwitchStmt;
+        NodeKind myKind() {return kind;}
+
         SwitchStmt(Ptr pred, Ptr act, tok::Token &o)
             : Node2(move(pred), move(act))
         {
@@ -88,6 +110,9 @@ namespace ast
 
     struct WhileStmt : public Node2
     {
+        static const NodeKind kind = NodeKind::WhileStmt;
+        NodeKind myKind() {return kind;}
+
         WhileStmt(Ptr pred, Ptr act, tok::Token &o)
             : Node2(move(pred), move(act))
         {
@@ -98,6 +123,9 @@ namespace ast
 
     struct ReturnStmt : public Node1
     {
+        static const NodeKind kind = NodeKind::ReturnStmt;
+        NodeKind myKind() {return kind;}
+
         ReturnStmt(Ptr arg, tok::Token &o)
             : Node1(move(arg))
         {
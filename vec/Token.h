@@ -4,6 +4,7 @@
 #include "Location.h"
 
 #include <string>
+#include <functional>
 
 namespace llvm
 {
@@ -31,6 +32,16 @@ inline Ident mkIdent(int v)
     return ret;
 }
 
+namespace std
+{
+    //so Idents can be used in unordered containers
+    template<>
+    struct hash<Ident>
+    {
+        size_t operator()(Ident i) const {return hash<int>()(i);}
+    };
+}
+
 namespace tok
 {
     namespace prec
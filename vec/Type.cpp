@@ -8,6 +8,7 @@
 
 #include <list>
 #include <algorithm>
+#include <cassert>
 
 using namespace par;
 using namespace typ;
@@ -28,7 +29,12 @@ struct TypeNodeB
     //exact comparison with param substitution used when inserting
     virtual bool insertCompare (TypeNodeB* toAdd) = 0;
 
-    virtual TypeNodeB* clone(TypeManager*) = 0;
+    //structural hash used when inserting. nodes that insertCompare equal must hash
+    //equal. children are already unique, so they are hashed by address, not recursively
+    virtual size_t hash() = 0;
+
+    //copy this node with params replaced according to s. may return an existing node
+    virtual TypeNodeB* clone(TypeManager*, Substitution& s) = 0;
 
     virtual void print(std::ostream&) = 0;
 
@@ -55,7 +61,8 @@ struct FuncNode : public TypeNode<FuncNode>
     TypeNodeB *ret, *arg;
     TypeCompareResult compareTo(FuncNode* other);
     bool insertCompareTo(FuncNode* other);
-    TypeNodeB* clone(TypeManager*);
+    size_t hash();
+    TypeNodeB* clone(TypeManager*, Substitution&);
     void print(std::ostream&);
     void createLLVMType();
 };
@@ -66,7 +73,21 @@ struct ListNode : public TypeNode<ListNode>
     TypeNodeB* contents;
     TypeCompareResult compareTo(ListNode* other);
     bool insertCompareTo(ListNode* other);
-    TypeNodeB* clone(TypeManager*);
+    size_t hash();
+    TypeNodeB* clone(TypeManager*, Substitution&);
+    void print(std::ostream&);
+    void createLLVMType();
+};
+
+//a dense multidimensional array. the shape and strides are only known at runtime
+struct TensorNode : public TypeNode<TensorNode>
+{
+    int rank;
+    TypeNodeB* contents;
+    TypeCompareResult compareTo(TensorNode* other);
+    bool insertCompareTo(TensorNode* other);
+    size_t hash();
+    TypeNodeB* clone(TypeManager*, Substitution&);
     void print(std::ostream&);
     void createLLVMType();
 };
@@ -76,7 +97,8 @@ struct TupleNode : public TypeNode<TupleNode>
     std::vector<std::pair<TypeNodeB*, Ident>> conts;
     TypeCompareResult compareTo(TupleNode* other);
     bool insertCompareTo(TupleNode* other);
-    TypeNodeB* clone(TypeManager*);
+    size_t hash();
+    TypeNodeB* clone(TypeManager*, Substitution&);
     void print(std::ostream&);
     void createLLVMType();
 };
@@ -86,7 +108,8 @@ struct RefNode : public TypeNode<RefNode>
     TypeNodeB* contents;
     TypeCompareResult compareTo(RefNode* other);
     bool insertCompareTo(RefNode* other);
-    TypeNodeB* clone(TypeManager*);
+    size_t hash();
+    TypeNodeB* clone(TypeManager*, Substitution&);
     void print(std::ostream&);
     void createLLVMType();
 };
@@ -101,7 +124,8 @@ struct NamedNode : public TypeNode<NamedNode>
     std::list<TypeNodeB*> args;
     TypeCompareResult compareTo(NamedNode*);
     bool insertCompareTo(NamedNode* other);
-    TypeNodeB* clone(TypeManager*);
+    size_t hash();
+    TypeNodeB* clone(TypeManager*, Substitution&);
     void print(std::ostream&);
     void createLLVMType();
 };
@@ -109,12 +133,11 @@ struct NamedNode : public TypeNode<NamedNode>
 struct ParamNode : public TypeNode<ParamNode>
 {
     Ident name;
-    TypeNodeB* sub; //the type this temporarily represents while substituting
     TypeCompareResult compareTo(ParamNode* other);
     bool insertCompareTo(ParamNode* other);
-    TypeNodeB* clone(TypeManager*);
+    size_t hash();
+    TypeNodeB* clone(TypeManager*, Substitution&);
     void print(std::ostream&);
-    ParamNode() : sub(0) {}
     void createLLVMType();
 };
 
@@ -128,25 +151,46 @@ struct PrimitiveNode : public TypeNode<PrimitiveNode>
     }
     TypeCompareResult compareTo(PrimitiveNode* other) {return this == other;}
     bool insertCompareTo(PrimitiveNode* other) {return this == other;}
-    TypeNodeB* clone(TypeManager*) {return this;}
+    size_t hash() {return size_t(this);}
+    TypeNodeB* clone(TypeManager*, Substitution&) {return this;}
     void print(std::ostream& os) {os << name;}
     void createLLVMType() {}
 };
 
-//get a version of this with temporary param subs
-//return true if it did something
-bool sub(TypeNodeB*& node)
+//a single substitution in progress
+struct Substitution
 {
-    ParamNode* pn = dynamic_cast<ParamNode*>(node);
-    if (pn && pn->sub)
-    {
-        node = pn->sub;
-        return true;
-    }
-    else
-        return false;
+    const std::map<Ident, TypeNodeB*>& params;
+    //nodes already cloned during this substitution, so shared subtrees are only copied once
+    std::unordered_map<TypeNodeB*, TypeNodeB*> done;
+
+    Substitution(const std::map<Ident, TypeNodeB*>& p) : params(p) {}
+};
+
+//mix h into seed. same idea as boost::hash_combine
+inline void hashCombine(size_t& seed, size_t h)
+{
+    seed ^= h + 0x9e3779b9 + (seed << 6) + (seed >> 2);
 }
 
+//hash a child by address. this agrees with insertCompare because children are unique
+inline void hashChild(size_t& seed, TypeNodeB* node)
+{
+    hashCombine(seed, size_t(node));
+}
+
+//distinguishes node kinds that happen to have the same children
+enum HashSeed
+{
+    FuncSeed = 1,
+    ListSeed,
+    TupleSeed,
+    RefSeed,
+    NamedSeed,
+    ParamSeed,
+    TensorSeed
+};
+
 //also strip names
 TypeCompareResult dename(TypeNodeB*& node)
 {
@@ -202,17 +246,6 @@ TypeCompareResult TypeNode<T>::compare (TypeNodeB* other)
 template<class T>
 bool TypeNode<T>::insertCompare (TypeNodeB* toAdd)
 {
-    //don't call insertCompare again, in case type is self referential ie
-    // type foo?T = ?T;
-    // type bar?T = foo!T;
-    // ?T is set to sub for itself which is entirely valid, but it should stop there
-    //only sub in toAdd because we don't want to mess with this.
-    //sub before doing equality comparison otherwise params will not work
-    sub(toAdd);
-
-    //don't early out
-    //TODO: can't we early out if no subs are set?
-    //only call compare again if either function did something, otherwise fall through
     TypeNodeB* realThis = this;
 
     if (T* toAddT = exact_cast<T*>(toAdd)) //see if it's one of us
@@ -231,14 +264,30 @@ bool FuncNode::insertCompareTo(FuncNode* other)
     return ret->insertCompare(other->ret) && arg->insertCompare(other->arg);
 }
 
-TypeNodeB* FuncNode::clone(TypeManager* mgr)
+size_t FuncNode::hash()
+{
+    size_t h = FuncSeed;
+    hashChild(h, ret);
+    hashChild(h, arg);
+    return h;
+}
+
+TypeNodeB* FuncNode::clone(TypeManager* mgr, Substitution& s)
 {
     FuncNode* copy = new FuncNode();
-    copy->ret = mgr->clone(ret);
-    copy->arg = mgr->clone(arg);
+    copy->ret = mgr->clone(ret, s);
+    copy->arg = mgr->clone(arg, s);
     return copy;
 }
 
+//fixed length lists are passed by pointer, instead of copying the whole array
+inline llvm::Type* argLLVMType(TypeNodeB* arg)
+{
+    if (llvm::isa<llvm::ArrayType>(arg->llvm_t))
+        return llvm::PointerType::getUnqual(arg->llvm_t);
+    return arg->llvm_t;
+}
+
 void FuncNode::createLLVMType()
 {
     llvm::SmallVector<llvm::Type*, 5> llvm_args;
@@ -246,9 +295,9 @@ void FuncNode::createLLVMType()
     TupleNode* allArgs = exact_cast<TupleNode*>(arg);
     if (allArgs)
         for (auto a : allArgs->conts)
-            llvm_args.push_back(a.first->llvm_t);
+            llvm_args.push_back(argLLVMType(a.first));
     else
-        llvm_args.push_back(arg->llvm_t);
+        llvm_args.push_back(argLLVMType(arg));
 
     llvm_t = llvm::FunctionType::get(ret->llvm_t, llvm_args, false);
 }
@@ -260,28 +309,47 @@ void FuncNode::print(std::ostream &out)
     arg->print(out);
 }
 
+//fixed and variable length lists have different representations, so they don't convert
 TypeCompareResult ListNode::compareTo(ListNode* other)
 {
+    if (length != other->length)
+        return TypeCompareResult::invalid;
     return contents->compare(other->contents);
 }
 
 bool ListNode::insertCompareTo(ListNode* other)
 {
-    return contents->insertCompare(other->contents);
+    return length == other->length && contents->insertCompare(other->contents);
+}
+
+size_t ListNode::hash()
+{
+    size_t h = ListSeed;
+    hashCombine(h, length);
+    hashChild(h, contents);
+    return h;
 }
 
-TypeNodeB* ListNode::clone(TypeManager* mgr)
+TypeNodeB* ListNode::clone(TypeManager* mgr, Substitution& s)
 {
     ListNode* copy = new ListNode(*this);
-    copy->contents = mgr->clone(contents);
+    copy->contents = mgr->clone(contents, s);
     return copy;
 }
 
 void ListNode::createLLVMType()
 {
+    if (length)
+    {
+        llvm_t = llvm::ArrayType::get(contents->llvm_t, length);
+        return;
+    }
+
+    //{data, length, capacity}. see cg::ListField and runtime/list.h
     llvm_t = llvm::StructType::get(
-        llvm::Type::getInt32Ty(llvm::getGlobalContext()),
         llvm::PointerType::getUnqual(contents->llvm_t),
+        llvm::Type::getInt32Ty(llvm::getGlobalContext()),
+        llvm::Type::getInt32Ty(llvm::getGlobalContext()),
         nullptr
         );
 }
@@ -291,6 +359,55 @@ void ListNode::print(std::ostream &out)
     out << "[ ";
     contents->print(out);
     out << " ]";
+    if (length)
+        out << '!' << length;
+}
+
+TypeCompareResult TensorNode::compareTo(TensorNode* other)
+{
+    if (rank != other->rank)
+        return TypeCompareResult::invalid;
+    return contents->compare(other->contents);
+}
+
+bool TensorNode::insertCompareTo(TensorNode* other)
+{
+    return rank == other->rank && contents->insertCompare(other->contents);
+}
+
+size_t TensorNode::hash()
+{
+    size_t h = TensorSeed;
+    hashCombine(h, rank);
+    hashChild(h, contents);
+    return h;
+}
+
+TypeNodeB* TensorNode::clone(TypeManager* mgr, Substitution& s)
+{
+    TensorNode* copy = new TensorNode(*this);
+    copy->contents = mgr->clone(contents, s);
+    return copy;
+}
+
+void TensorNode::createLLVMType()
+{
+    //{data, shape, strides}. see cg::TensorField and runtime/tensor.h
+    llvm::Type* dims_t = llvm::ArrayType::get(
+        llvm::Type::getInt32Ty(llvm::getGlobalContext()), rank);
+    llvm_t = llvm::StructType::get(
+        llvm::PointerType::getUnqual(contents->llvm_t),
+        dims_t,
+        dims_t,
+        nullptr
+        );
+}
+
+void TensorNode::print(std::ostream &out)
+{
+    out << "[ ";
+    contents->print(out);
+    out << ", " << rank << " ]";
 }
 
 TypeCompareResult TupleNode::compareTo(TupleNode* other)
@@ -326,11 +443,22 @@ bool TupleNode::insertCompareTo(TupleNode* other)
     return true;
 }
 
-TypeNodeB* TupleNode::clone(TypeManager* mgr)
+size_t TupleNode::hash()
+{
+    size_t h = TupleSeed;
+    for (auto& t : conts)
+    {
+        hashChild(h, t.first);
+        hashCombine(h, t.second);
+    }
+    return h;
+}
+
+TypeNodeB* TupleNode::clone(TypeManager* mgr, Substitution& s)
 {
     TupleNode* copy = new TupleNode();
     for (auto t : conts)
-        copy->conts.emplace_back(mgr->clone(t.first), t.second);
+        copy->conts.emplace_back(mgr->clone(t.first, s), t.second);
     return copy;
 }
 
@@ -363,13 +491,20 @@ TypeCompareResult RefNode::compareTo(RefNode* other)
 
 bool RefNode::insertCompareTo(RefNode* other)
 {
-    return contents->compare(other).isValid();
+    return contents->insertCompare(other->contents);
+}
+
+size_t RefNode::hash()
+{
+    size_t h = RefSeed;
+    hashChild(h, contents);
+    return h;
 }
 
-TypeNodeB* RefNode::clone(TypeManager* mgr)
+TypeNodeB* RefNode::clone(TypeManager* mgr, Substitution& s)
 {
     RefNode* copy = new RefNode();
-    copy->contents = mgr->clone(contents);
+    copy->contents = mgr->clone(contents, s);
     return copy;
 }
 
@@ -398,13 +533,24 @@ bool NamedNode::insertCompareTo(NamedNode* other)
             && std::equal(args.begin(), args.end(), other->args.begin());
 }
 
-TypeNodeB* NamedNode::clone(TypeManager* mgr)
+size_t NamedNode::hash()
+{
+    //named nodes are compared exactly (no subs) so hash them exactly
+    size_t h = NamedSeed;
+    hashCombine(h, name);
+    hashCombine(h, size_t(type));
+    for (auto a : args)
+        hashCombine(h, size_t(a));
+    return h;
+}
+
+TypeNodeB* NamedNode::clone(TypeManager* mgr, Substitution& s)
 {
     NamedNode* copy = new NamedNode();
     for (auto t : args)
-        copy->args.push_back(mgr->clone(t));
+        copy->args.push_back(mgr->clone(t, s));
     copy->name = name;
-    copy->type = mgr->clone(type);
+    copy->type = mgr->clone(type, s);
     return copy;
 }
 
@@ -455,16 +601,24 @@ bool ParamNode::insertCompareTo(ParamNode* other)
     return name == other->name;
 }
 
-TypeNodeB* ParamNode::clone(TypeManager*)
+size_t ParamNode::hash()
 {
-    assert(sub && "sub should be set here");
-    return sub;
+    size_t h = ParamSeed;
+    hashCombine(h, name);
+    return h;
+}
+
+//params that aren't being substituted stay as they are
+TypeNodeB* ParamNode::clone(TypeManager*, Substitution& s)
+{
+    auto it = s.params.find(name);
+    return it != s.params.end() ? it->second : this;
 }
 
 void ParamNode::createLLVMType()
 {
     //this should probably not be used for anything
-    llvm_t = llvm::StructType::create(llvm::getGlobalContext(), "_P_" + Global().getIdent(name));
+    llvm_t = llvm::StructType::create(llvm::getGlobalContext(), "_P_" + (std::string)Global().getIdent(name));
 }
 
 void ParamNode::print(std::ostream &out)
@@ -568,6 +722,7 @@ T ## Type Type::get ## T() const \
 
 ListSubGetter(Func)
 ListSubGetter(List)
+ListSubGetter(Tensor)
 ListSubGetter(Tuple)
 ListSubGetter(Ref)
 ListSubGetter(Param)
@@ -585,6 +740,10 @@ Type FuncType::arg() {return und_node->arg;}
 Type FuncType::ret() {return und_node->ret;}
 
 Type ListType::conts() {return und_node->contents;}
+int ListType::length() {return und_node->length;}
+
+Type TensorType::conts() {return und_node->contents;}
+int TensorType::rank() {return und_node->rank;}
 
 Type TupleType::elem(size_t pos) {return und_node->conts[pos].first;}
 size_t TupleType::size() {return und_node->conts.size();}
@@ -628,6 +787,14 @@ Type TypeManager::makeList(Type conts, int length)
     return unique(n);
 }
 
+Type TypeManager::makeTensor(Type conts, int rank)
+{
+    TensorNode* n = new TensorNode();
+    n->contents = conts;
+    n->rank = rank;
+    return unique(n);
+}
+
 Type TypeManager::makeRef(Type conts)
 {
     RefNode* n = new RefNode();
@@ -646,8 +813,8 @@ Type TypeManager::makeNamed(Type conts, Ident name, std::vector<Ident>& params,
     while (n->args.size() < params.size())
     {
         Ident alias = Global().addIdent(
-            "<" + Global().getIdent(params[n->args.size()]) + " in "
-            + Global().getIdent(n->name) + ">");
+            "<" + (std::string)Global().getIdent(params[n->args.size()]) + " in "
+            + (std::string)Global().getIdent(n->name) + ">");
         n->args.push_back(typ::mgr.makeParam(alias));
     }
 
@@ -723,17 +890,22 @@ TypeNodeB* TypeManager::unique(TypeNodeB* n)
     if (dynamic_cast<PrimitiveNode*>(n))
         return n;
 
-    for (auto it : nodes)
+    //only nodes with the same hash can possibly be equal
+    size_t h = n->hash();
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    auto range = table.equal_range(h);
+    for (auto it = range.first; it != range.second; ++it)
     {
-        if (it->insertCompare(n))
+        if (it->second->insertCompare(n))
         {
-            if (it != n) //don't delete things we already own
+            if (it->second != n) //don't delete things we already own
                 delete n;
-            return it;
+            return it->second;
         }
     }
 
     nodes.push_back(n);
+    table.insert(std::make_pair(h, n));
 
     if (makeLLVMImmediately)
         n->createLLVMType();
@@ -741,6 +913,19 @@ TypeNodeB* TypeManager::unique(TypeNodeB* n)
     return n;
 }
 
+size_t TypeManager::scanFor(Type t)
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    size_t compared = 0;
+    for (auto it : nodes)
+    {
+        ++compared;
+        if (it->insertCompare(t.node))
+            break;
+    }
+    return compared;
+}
+
 
 void TypeManager::makeLLVMTypes()
 {
@@ -760,35 +945,271 @@ void TypeManager::printAll(std::ostream& os)
     }
 }
 
+namespace
+{
+    //binds the params in pattern to whatever is in the same place in actual. false if they
+    //don't have the same shape, or a param would have to be two different things
+    bool deduceParams(TypeNodeB* pattern, TypeNodeB* actual,
+        std::map<Ident, TypeNodeB*>& subs)
+    {
+        if (ParamNode* p = dynamic_cast<ParamNode*>(pattern))
+        {
+            auto it = subs.find(p->name);
+            if (it == subs.end())
+            {
+                subs[p->name] = actual;
+                return true;
+            }
+            return it->second == actual;
+        }
+
+        if (NamedNode* n = dynamic_cast<NamedNode*>(actual))
+            return deduceParams(pattern, n->type, subs);
+
+        if (ListNode* l = dynamic_cast<ListNode*>(pattern))
+        {
+            ListNode* a = dynamic_cast<ListNode*>(actual);
+            return a && a->length == l->length && deduceParams(l->contents, a->contents, subs);
+        }
+        if (TensorNode* t = dynamic_cast<TensorNode*>(pattern))
+        {
+            TensorNode* a = dynamic_cast<TensorNode*>(actual);
+            return a && a->rank == t->rank && deduceParams(t->contents, a->contents, subs);
+        }
+        if (RefNode* r = dynamic_cast<RefNode*>(pattern))
+        {
+            RefNode* a = dynamic_cast<RefNode*>(actual);
+            return a && deduceParams(r->contents, a->contents, subs);
+        }
+        if (FuncNode* f = dynamic_cast<FuncNode*>(pattern))
+        {
+            FuncNode* a = dynamic_cast<FuncNode*>(actual);
+            return a && deduceParams(f->ret, a->ret, subs) && deduceParams(f->arg, a->arg, subs);
+        }
+        if (TupleNode* t = dynamic_cast<TupleNode*>(pattern))
+        {
+            TupleNode* a = dynamic_cast<TupleNode*>(actual);
+            if (!a || a->conts.size() != t->conts.size())
+                return false;
+            for (size_t i = 0; i < t->conts.size(); ++i)
+                if (!deduceParams(t->conts[i].first, a->conts[i].first, subs))
+                    return false;
+            return true;
+        }
+
+        //no params under here. compare decides if it fits
+        return true;
+    }
+}
+
+Type TypeManager::instantiate(Type func, Type arg)
+{
+    std::map<Ident, TypeNodeB*> subs;
+    if (!deduceParams(func.getFunc().arg().node, arg.node, subs))
+        return error;
+    if (subs.empty())
+        return func;
+    return substitute(func, subs);
+}
+
 //ok here's how this works. whenever a named type is used, we run this fuction
 //on its contents, which creates (if neccesary) a new node which represents the type with
-//exactly these arguments. we do this by temporarily replacing parameter nodes
-//with the values that they represent, then making a copy of and re-uniqing
-//all nodes below it. we can do this without interfering with other types because
-//we will at this point already have nodes for any contained types.
-//note that we have to be careful with the old node, because things are pointing to it
+//exactly these arguments. we do this by making a copy of and re-uniqing all nodes
+//reachable from old, with params replaced by what subs says they represent. we can do
+//this without interfering with other types because we will at this point already have
+//nodes for any contained types, and we never modify existing nodes.
+//the result only depends on (old, subs), so it is cached.
 Type TypeManager::substitute(Type old, std::map<Ident, TypeNodeB*>& subs)
 {
-    //first set parameter subs
-    for (auto node : nodes)
-        if (ParamNode* pn = dynamic_cast<ParamNode*>(node))
-            if (subs.count(pn->name))
-                pn->sub = subs[pn->name];
+    //std::map iterates in order, so this is a canonical key
+    InstKey key;
+    key.type = old.node;
+    key.subs.assign(subs.begin(), subs.end());
 
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    auto cached = instantiations.find(key);
+    if (cached != instantiations.end())
+        return cached->second;
 
-    TypeNodeB* newNode = clone(old);
+    Substitution s(subs);
+    TypeNodeB* newNode = clone(old, s);
 
-    //finally clear parameter subs
-    for (auto node : nodes)
-        if (ParamNode* pn = dynamic_cast<ParamNode*>(node))
-            pn->sub = 0;
-        
+    instantiations[move(key)] = newNode;
     return newNode;
 }
 
-TypeNodeB* TypeManager::clone(TypeNodeB* n)
+size_t TypeManager::InstKeyHash::operator()(const InstKey& k) const
+{
+    size_t h = size_t(k.type);
+    for (auto& sub : k.subs)
+    {
+        hashCombine(h, sub.first);
+        hashCombine(h, size_t(sub.second));
+    }
+    return h;
+}
+
+TypeNodeB* TypeManager::clone(TypeNodeB* n, Substitution& s)
+{
+    auto it = s.done.find(n);
+    if (it != s.done.end())
+        return it->second;
+
+    TypeNodeB* ret = unique(n->clone(this, s));
+    s.done[n] = ret;
+    return ret;
+}
+
+namespace
+{
+    //the order of this is part of the module cache format
+    PrimitiveNode* const primitives[] =
+    {
+        &nint8, &nint16, &nint32, &nint64,
+        &nfloat32, &nfloat64, &nfloat80,
+        &nboolean,
+        &nany, &nnull, &noverload, &nerror, &nundeclared
+    };
+
+    const int numPrimitives = sizeof(primitives) / sizeof(primitives[0]);
+}
+
+int TypeTable::add(Type t)
+{
+    auto found = indices.find(t.node);
+    if (found != indices.end())
+        return found->second;
+
+    //children first, so everything an entry refers to comes before it
+    Entry e;
+    TypeNodeB* n = t.node;
+    if (PrimitiveNode* prim = dynamic_cast<PrimitiveNode*>(n))
+    {
+        e.kind = PRIMITIVE;
+        e.a = int(std::find(primitives, primitives + numPrimitives, prim) - primitives);
+        assert(e.a < numPrimitives && "unknown primitive type");
+    }
+    else if (ListNode* list = dynamic_cast<ListNode*>(n))
+    {
+        e.kind = LIST;
+        e.a = add(list->contents);
+        e.b = list->length;
+    }
+    else if (TensorNode* tensor = dynamic_cast<TensorNode*>(n))
+    {
+        e.kind = TENSOR;
+        e.a = add(tensor->contents);
+        e.b = tensor->rank;
+    }
+    else if (TupleNode* tuple = dynamic_cast<TupleNode*>(n))
+    {
+        e.kind = TUPLE;
+        for (auto& elem : tuple->conts)
+            e.elems.emplace_back(add(elem.first), elem.second);
+    }
+    else if (RefNode* ref = dynamic_cast<RefNode*>(n))
+    {
+        e.kind = REF;
+        e.a = add(ref->contents);
+    }
+    else if (FuncNode* func = dynamic_cast<FuncNode*>(n))
+    {
+        e.kind = FUNC;
+        e.a = add(func->ret);
+        e.b = add(func->arg);
+    }
+    else if (NamedNode* named = dynamic_cast<NamedNode*>(n))
+    {
+        e.kind = NAMED;
+        e.a = add(named->type);
+        e.name = named->name;
+        for (auto arg : named->args)
+            e.elems.emplace_back(add(arg), Global().reserved.null);
+    }
+    else if (ParamNode* param = dynamic_cast<ParamNode*>(n))
+    {
+        e.kind = PARAM;
+        e.name = param->name;
+    }
+    else
+        assert(false && "unknown type node");
+
+    int idx = int(entries.size());
+    entries.push_back(std::move(e));
+    indices[n] = idx;
+    return idx;
+}
+
+bool TypeTable::build()
 {
-    return unique(n->clone(this));
+    built.clear();
+    for (auto& e : entries)
+    {
+        //entries may only refer to ones that are already built
+        int done = int(built.size());
+        if (e.kind != PRIMITIVE && e.kind != PARAM && e.kind != TUPLE
+            && (e.a < 0 || e.a >= done))
+            return false;
+        for (auto& elem : e.elems)
+            if (elem.first < 0 || elem.first >= done)
+                return false;
+
+        TypeNodeB* n;
+        switch (e.kind)
+        {
+        case PRIMITIVE:
+            if (e.a < 0 || e.a >= numPrimitives)
+                return false;
+            n = primitives[e.a];
+            break;
+        case LIST:
+            n = mgr.makeList(built[e.a], e.b);
+            break;
+        case TENSOR:
+            n = mgr.makeTensor(built[e.a], e.b);
+            break;
+        case TUPLE:
+        {
+            TupleBuilder builder;
+            for (auto& elem : e.elems)
+                builder.push_back(built[elem.first], elem.second);
+            n = mgr.makeTuple(builder);
+            break;
+        }
+        case REF:
+            n = mgr.makeRef(built[e.a]);
+            break;
+        case FUNC:
+        {
+            if (e.b < 0 || e.b >= done)
+                return false;
+            //not makeFunc, the argument is already a tuple
+            FuncNode* func = new FuncNode();
+            func->ret = built[e.a];
+            func->arg = built[e.b];
+            n = mgr.unique(func);
+            break;
+        }
+        case NAMED:
+        {
+            //not makeNamed, the real type already has the args subbed in
+            NamedNode* named = new NamedNode();
+            named->name = e.name;
+            named->type = built[e.a];
+            for (auto& elem : e.elems)
+                named->args.push_back(built[elem.first]);
+            n = mgr.unique(named);
+            break;
+        }
+        case PARAM:
+            n = mgr.makeParam(e.name);
+            break;
+        default:
+            return false;
+        }
+        built.push_back(n);
+    }
+    return true;
 }
 
 }
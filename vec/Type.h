@@ -5,6 +5,8 @@
 #include <list>
 #include <map>
 #include <vector>
+#include <unordered_map>
+#include <mutex>
 #include "Token.h"
 
 namespace utl
@@ -28,6 +30,7 @@ namespace typ
 
     class FuncType;
     class ListType;
+    class TensorType;
     class TupleType;
     class RefType;
     class NamedType;
@@ -35,6 +38,7 @@ namespace typ
     class PrimitiveType;
 
     class TypeCompareResult;
+    struct Substitution;
 
     class Type
     {
@@ -68,6 +72,8 @@ namespace typ
 
         //this allows use in stl map for example
         bool operator<(const Type& other) const {return node < other.node;}
+        //and this allows use in unordered containers
+        size_t hash() const {return size_t(node);}
 
         std::string to_str();
 
@@ -78,6 +84,7 @@ namespace typ
         //the const is kind of a lie but it helps when you have types in maps
         FuncType getFunc() const;
         ListType getList() const;
+        TensorType getTensor() const;
         TupleType getTuple() const;
         RefType getRef() const;
         NamedType getNamed() const;
@@ -87,12 +94,14 @@ namespace typ
         friend class TypeManager;
         friend class TupleBuilder;
         friend class NamedBuilder;
+        friend class TypeTable;
     };
 
     std::ostream& operator<<(std::ostream& lhs, Type& rhs);
 
     struct FuncNode;
     struct ListNode;
+    struct TensorNode;
     struct TupleNode;
     struct RefNode;
     struct NamedNode;
@@ -115,6 +124,17 @@ namespace typ
         ListNode* und_node;
     public:
         Type conts();
+        int length(); //0 unless it's a fixed length list
+        bool isValid() {return und_node != 0;}
+        friend class Type;
+    };
+
+    class TensorType : public Type
+    {
+        TensorNode* und_node;
+    public:
+        Type conts();
+        int rank();
         bool isValid() {return und_node != 0;}
         friend class Type;
     };
@@ -201,9 +221,64 @@ namespace typ
         void push_back(Type arg) {namedConts.push_back(arg);}
     };
 
+    //flattens types into entries that only refer to entries before them, so they can be
+    //written out and built again in another run. used by the module cache
+    class TypeTable
+    {
+    public:
+        enum Kind
+        {
+            PRIMITIVE,
+            LIST,
+            TENSOR,
+            TUPLE,
+            REF,
+            FUNC,
+            NAMED,
+            PARAM,
+            NUM_KINDS
+        };
+
+        struct Entry
+        {
+            Kind kind;
+            int a; //which primitive, the contents, the return type, or the real type
+            int b; //list length, tensor rank, or the argument type
+            Ident name; //of named types and params
+            std::vector<std::pair<int, Ident>> elems; //tuple elements, or named type args
+
+            Entry() : kind(PRIMITIVE), a(0), b(0), name(mkIdent(0)) {}
+        };
+
+        std::vector<Entry> entries;
+
+        //index of t's entry, adding entries for it and everything it's made of if needed
+        int add(Type t);
+
+        //build the types for all of the entries. returns false if they don't make sense
+        bool build();
+        //type of entry idx. only valid after build
+        Type get(int idx) {return built[idx];}
+        size_t size() {return entries.size();}
+
+    private:
+        std::unordered_map<TypeNodeB*, int> indices; //for add
+        std::vector<TypeNodeB*> built; //for get
+    };
+
+    //the make* functions can be called from any thread. nodes never change once they're
+    //made, so reading them doesn't need a lock
     class TypeManager
     {
+        friend class TypeTable;
+
+        //for nodes, table and instantiations. recursive because substituting makes nodes
+        std::recursive_mutex mutex;
+
+        //all nodes, in order of creation
         std::list<TypeNodeB*> nodes;
+        //hash -> nodes with that hash, for uniquing
+        std::unordered_multimap<size_t, TypeNodeB*> table;
 
         //set this flag after making llvm types so they get created if we need to add
         //new types
@@ -216,6 +291,20 @@ namespace typ
         //creates a new type with params repaced by the specified types
         Type substitute(Type old, std::map<Ident, TypeNodeB*>& subs);
 
+        //instantiation cache for substitute
+        struct InstKey
+        {
+            TypeNodeB* type;
+            std::vector<std::pair<Ident, TypeNodeB*>> subs;
+            bool operator==(const InstKey& other) const
+            {return type == other.type && subs == other.subs;}
+        };
+        struct InstKeyHash
+        {
+            size_t operator()(const InstKey& k) const;
+        };
+        std::unordered_map<InstKey, TypeNodeB*, InstKeyHash> instantiations;
+
         //internal version of this function
         Type makeNamed(Type conts, Ident name, std::vector<Ident>& params, std::list<TypeNodeB*>& args);
 
@@ -225,6 +314,7 @@ namespace typ
         ~TypeManager();
 
         Type makeList(Type conts, int length = 0);
+        Type makeTensor(Type conts, int rank);
         Type makeRef(Type conts);
         Type makeParam(Ident name);
         Type makeFunc(Type ret, Type arg);
@@ -235,15 +325,24 @@ namespace typ
         Type fixExternNamed(NamedType toFix, Type conts, std::vector<Ident>& params);
         Type makeNamed(Type conts, Ident name);
 
+        //func with the params in its argument type deduced from arg and substituted
+        //everywhere. func itself if it has no params, or error if arg doesn't fit
+        Type instantiate(Type func, Type arg);
+
         //these must be made after importing so all types are complete
         void makeLLVMTypes();
 
         void printAll(std::ostream& os);
 
+        //unique t's node the way it used to be done, by comparing it against every node
+        //until one matches. returns how many it compared. only for bench/types, to have
+        //something to compare against
+        size_t scanFor(Type t);
+
         //these functions aren't really part of the public interface but its simpler to make them public
 
         //performs a deep copy, keeping everything unique and subbing in params
-        TypeNodeB* clone(TypeNodeB* n);
+        TypeNodeB* clone(TypeNodeB* n, Substitution& s);
     };
 
     extern TypeManager mgr;
@@ -74,6 +74,7 @@ void Parser::parseTypeEnd()
 single-type
     : '{' type-list '}'
     | '[' type ']'
+    | '[' type ',' int-const ']'
     | ('int' | 'float') ('!' int-const)?
     | '?' | '?' IDENT
     | '@' type
@@ -123,7 +124,8 @@ void Parser::parseSingle()
 
 /*
 single-type
-    : '[' type ']'
+    : '[' type ']' ('!' int-const)?
+    | '[' type ',' int-const ']'
     ;
 */
 void Parser::parseList()
@@ -133,6 +135,26 @@ void Parser::parseList()
     if (backtrackStatus == IsBacktracking)
         return;
 
+    //tensor
+    if (lexer->Peek() == tok::comma)
+    {
+        tok::Token to;
+        lexer->Advance();
+        if (!lexer->Expect(tok::integer, to) || to.value.int_v < 1)
+        {
+            START_BACKTRACK;
+            err::ExpectedAfter(lexer, "tensor rank", "','");
+            to.value.int_v = 1;
+        }
+        if (!lexer->Expect(listEnd))
+        {
+            START_BACKTRACK;
+            err::ExpectedAfter(lexer, "']'", "tensor rank");
+        }
+        type = typ::mgr.makeTensor(type, int(to.value.int_v));
+        return;
+    }
+
     if (!lexer->Expect(listEnd))
     {
         //could be a declaration or something
@@ -145,7 +167,7 @@ void Parser::parseList()
         tok::Token to;
         if (lexer->Expect(tok::integer, to))
         {
-            type = typ::mgr.makeList(type, to.value.ident_v);
+            type = typ::mgr.makeList(type, int(to.value.int_v));
         }
         else //don't backtrack?
         {
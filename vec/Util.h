@@ -11,6 +11,7 @@
 namespace ast
 {
     class Node0;
+    template<class To> To exact_node_cast(Node0* from);
 }
 
 //normally it's better to leave on std:: but this more than doubles the length
@@ -19,14 +20,28 @@ using std::move;
 //#define exact_cast dynamic_cast
 
 #ifndef exact_cast
+//AST nodes know their kind, which is cheaper to check than typeid
 template<class To, class From>
-To exact_cast(From from)
+To exact_cast_impl(From from, std::true_type)
+{
+    return ast::exact_node_cast<To>(from);
+}
+
+template<class To, class From>
+To exact_cast_impl(From from, std::false_type)
 {
     if (from != nullptr && typeid(typename std::remove_pointer<To>::type) == typeid(*from))
         return static_cast<To>(from);
     else
         return nullptr;
 }
+
+template<class To, class From>
+To exact_cast(From from)
+{
+    return exact_cast_impl<To>(from,
+        std::is_base_of<ast::Node0, typename std::remove_pointer<From>::type>());
+}
 #endif
 
 #ifdef _DEBUG
@@ -3,6 +3,7 @@
 #include "SemaNodes.h"
 #include <vector>
 #include <cstring>
+#include <cstdint>
 
 #include "LLVM.h"
 
@@ -221,4 +222,124 @@ Value Value::scalarSeq(size_t width)
     return new Level1SeqNode(width);
 }
 
+namespace
+{
+    enum ValTag : char
+    {
+        TAG_UNSET,
+        TAG_SCALAR,
+        TAG_SCALAR_SEQ,
+        TAG_SEQ
+    };
+
+    void putSize(std::vector<char>& out, size_t size)
+    {
+        uint32_t s = uint32_t(size);
+        out.insert(out.end(), (char*)&s, (char*)&s + sizeof(s));
+    }
+
+    bool getSize(const char*& b, const char* e, size_t& size)
+    {
+        uint32_t s;
+        if (size_t(e - b) < sizeof(s))
+            return false;
+        memcpy(&s, b, sizeof(s));
+        b += sizeof(s);
+        size = s;
+        return true;
+    }
+}
+
+bool Value::toBytes(std::vector<char>& out) const
+{
+    ValNode* n = node.get();
+    if (!n)
+        out.push_back(TAG_UNSET);
+    else if (ScalarNode* scalar = dynamic_cast<ScalarNode*>(n))
+    {
+        //refs into a sequence only have its width, the rest is zero
+        NormalScalarNode whole;
+        memset(whole.Get(), 0, sizeof(whole.val));
+        ScalarRefNode* ref = dynamic_cast<ScalarRefNode*>(scalar);
+        memcpy(whole.Get(), scalar->Get(), ref ? ref->memOwner->width : sizeof(whole.val));
+
+        out.push_back(TAG_SCALAR);
+        out.insert(out.end(), whole.Get(), whole.Get() + sizeof(whole.val));
+    }
+    else if (Level1SeqNode* seq = dynamic_cast<Level1SeqNode*>(n))
+    {
+        out.push_back(TAG_SCALAR_SEQ);
+        putSize(out, seq->width);
+        putSize(out, seq->val.size());
+        out.insert(out.end(), seq->val.begin(), seq->val.end());
+    }
+    else if (LevelNSeqNode* seq = dynamic_cast<LevelNSeqNode*>(n))
+    {
+        out.push_back(TAG_SEQ);
+        putSize(out, seq->val.size());
+        for (auto& v : seq->val)
+            if (!v.toBytes(out))
+                return false;
+    }
+    else //functions, refs, and errors
+        return false;
+
+    return true;
+}
+
+bool Value::fromBytes(const char*& b, const char* e, Value& out)
+{
+    if (b == e)
+        return false;
+
+    size_t width, size;
+    switch (*b++)
+    {
+    case TAG_UNSET:
+        out = Value();
+        return true;
+
+    case TAG_SCALAR:
+    {
+        auto scalar = std::make_shared<NormalScalarNode>();
+        if (size_t(e - b) < sizeof(scalar->val))
+            return false;
+        memcpy(scalar->Get(), b, sizeof(scalar->val));
+        b += sizeof(scalar->val);
+        out = Value(scalar);
+        return true;
+    }
+
+    case TAG_SCALAR_SEQ:
+    {
+        if (!getSize(b, e, width) || !getSize(b, e, size) || size_t(e - b) < size)
+            return false;
+        auto seq = std::make_shared<Level1SeqNode>(width);
+        seq->val.assign(b, b + size);
+        b += size;
+        out = Value(seq);
+        return true;
+    }
+
+    case TAG_SEQ:
+    {
+        if (!getSize(b, e, size))
+            return false;
+        auto seq = std::make_shared<LevelNSeqNode>();
+        for (size_t i = 0; i < size; ++i)
+        {
+            Value elem;
+            if (!fromBytes(b, e, elem))
+                return false;
+            seq->append(elem);
+        }
+        out = Value(seq);
+        return true;
+    }
+
+    default:
+        return false;
+    }
+}
+
 }
@@ -6,6 +6,7 @@
 
 #include <memory>
 #include <array>
+#include <vector>
 #include <type_traits>
 
 //this is implemented similarly to types, except that is likely that we won't need values
@@ -75,6 +76,11 @@ namespace val
         }
 
         ast::NPtr<ast::Lambda>::type& getFunc();
+
+        //flatten into bytes and back, for the module cache. scalars and sequences of them
+        //are all that can be flattened; toBytes returns false for anything else
+        bool toBytes(std::vector<char>& out) const;
+        static bool fromBytes(const char*& b, const char* e, Value& out);
     };
 }
         
@@ -4,6 +4,7 @@
 #include "LLVM.h"
 
 #include <cstdio>
+#include <cstdlib>
 #include <iostream>
 
 #define MAX_PATH 256
@@ -37,15 +38,63 @@ int main (int argc, char* argv[])
 
     GlobalData::create();
     llvm::llvm_shutdown_obj shutdown/*(multithreaded = false)*/; //clean up llvm upon exit
+
+    std::vector<std::string> paths;
+    for (size_t i = 1; i < params.size(); ++i)
+    {
+        if (params[i] == "--stats")
+            Global().options.stats = true;
+        else if (params[i] == "--dump-fusion")
+            Global().options.dumpFusion = true;
+        else if (params[i] == "--strict-fp")
+            Global().options.strictFP = true;
+        else if (params[i] == "--parallel")
+            Global().options.parallel = true;
+        else if (params[i] == "--run")
+            Global().options.run = true;
+        else if (params[i].compare(0, 8, "--cache=") == 0)
+            Global().moduleCache.setDir(params[i].substr(8));
+        else if (params[i] == "--no-cache")
+            Global().moduleCache.setDir("");
+        else if (params[i].size() > 2 && params[i].compare(0, 2, "-j") == 0
+            && params[i].find_first_not_of("0123456789", 2) == std::string::npos)
+            Global().options.jobs = atoi(params[i].c_str() + 2);
+        else if (params[i].size() == 3 && params[i].compare(0, 2, "-O") == 0
+            && params[i][2] >= '0' && params[i][2] <= '3')
+            Global().options.optLevel = params[i][2] - '0';
+        else if (params[i].compare(0, 6, "-emit=") == 0)
+        {
+            static const char* const kinds[] = {"ll", "bc", "obj", "exe"};
+            std::string kind = params[i].substr(6);
+            size_t k = 0;
+            while (k < 4 && kind != kinds[k])
+                ++k;
+            if (k == 4)
+            {
+                err::Error(err::fatal, tok::Location()) << "unknown output kind '" << kind
+                    << "', expected ll, bc, obj, or exe";
+                return 1;
+            }
+            Global().options.emit = GlobalData::Emit(k);
+        }
+        else
+            paths.push_back(params[i]);
+    }
     
     try
     {
 #ifdef _WIN32
         char fileName[MAX_PATH] = "";
         openDlg(fileName);
-        Global().ParseMainFile(fileName);
+        paths.assign(1, fileName);
+        Global().ParseMainFile(paths);
 #else
-        Global().ParseMainFile(params[1].c_str());
+        if (paths.empty())
+        {
+            err::Error(err::fatal, tok::Location()) << "no input file";
+            return 1;
+        }
+        Global().ParseMainFile(paths);
 #endif
     }
     catch (err::FatalError)
@@ -53,5 +102,8 @@ int main (int argc, char* argv[])
         err::Error(err::fatal, tok::Location()) << "could not recover from previous errors, aborting";
     }
 
+    if (Global().options.stats)
+        Global().PrintStats(std::cerr);
+
     return 0;
 }